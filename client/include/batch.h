@@ -0,0 +1,88 @@
+/********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  batch.h
+ *    Description:  This file is a sample batching function declare file.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时01分29秒"
+ *                 
+ ********************************************************************************/
+
+#ifndef  _BATCH_H_
+#define  _BATCH_H_
+
+#include "readconf.h"
+#include "packet.h"
+#include "database.h"
+
+// most samples packeted into one message
+#define BATCH_MAX_SAMPLES       64
+
+
+/*	description:	init batching stage between sampler and publisher, samples are grouped
+ *                  by $conf->batchcount, $conf->batchbytes and $conf->batchlinger
+ *	 input args:	
+ *					$conf : client configurations
+ *					$func : batch packet function
+ * return value:    <0: failure   0: success
+ */
+extern int batchInit(conf_t *conf, packBatchFunc func);
+
+
+/*	description:	add one sample into batch, batch is packeted when it's full by count,
+ *                  or this sample makes it larger than byte budget. Sample that doesn't
+ *                  fit starts next batch
+ *	 input args:	
+ *					$pack_info : sample
+ *                  $pack_buf  : buffer whitch will store packeted batch
+ *                  $size      : buffer size 
+ * return value:    <0: failure   0: sample is pending in batch   >0: packeted batch bytes
+ */
+extern int batchAdd(pack_info_t *pack_info, char *pack_buf, int size);
+
+
+/*	description:	packet pending samples now
+ *	 input args:	
+ *                  $pack_buf  : buffer whitch will store packeted batch
+ *                  $size      : buffer size 
+ * return value:    <0: failure   0: no pending sample   >0: packeted batch bytes
+ */
+extern int batchFlush(char *pack_buf, int size);
+
+
+/*	description:	get time until the oldest pending sample reaches linger time, so the
+ *                  event loop can sleep on it
+ * return value:    -1: no pending sample or no linger limit   >=0: milliseconds
+ */
+extern int batchTimeout(void);
+
+
+/*	description:	get samples record of last packeted batch, it's saved in database instead of
+ *                  packeted batch, so saved samples are packeted again when they are drained
+ *	 input args:	
+ *					$record : output, samples record in batch
+ * return value:    0: no record   >0: samples record bytes
+ */
+extern int batchRecord(char **record);
+
+
+/*	description:	packet samples of database records into one message, records are taken in
+ *                  order while message is within BATCH_MAX_SAMPLES samples and byte budget, no
+ *                  linger is waited for saved samples. record is never split, so the message is
+ *                  acknowledged by removing it's records. record without samples record magic is
+ *                  saved by older version, it's sent as it is alone, and samples record which
+ *                  can't be decoded is broken, it's dropped
+ *	 input args:	
+ *					$packs     : database records, oldest first
+ *					$count     : database records count
+ *					$used      : output, database records packeted
+ *                  $pack_buf  : buffer whitch will store packeted message
+ *                  $size      : buffer size 
+ * return value:    <0: first record can't be packeted   >0: packeted message bytes
+ */
+extern int batchStored(database_pack_t *packs, int count, int *used, char *pack_buf, int size);
+
+#endif
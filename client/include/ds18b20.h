@@ -25,6 +25,66 @@
 #ifndef  _DS18B20_H_
 #define  _DS18B20_H_
 
-extern int ds18b20GetTemperature(float *temp);
+#define DS18B20_SN_LEN          24
+
+typedef struct ds18b20_reading_s
+{
+    char        serial[DS18B20_SN_LEN];     // chipset serial number
+    int         mtemper;                    // sample temperature in milli-degrees Celsius
+} ds18b20_reading_t;
+
+
+/*	description:	parse w1_slave file content, reading with bad crc or power-on reset
+ *                  value 85000 is rejected
+ *	 input args:	
+ *					$buf     : w1_slave file content
+ *					$bytes   : content bytes
+ *					$mtemper : temperature output in milli-degrees Celsius
+ * return value:    <0: failure   0: success
+ */
+extern int ds18b20Parse(const char *buf, int bytes, int *mtemper);
+
+
+/*	description:	set wanted ds18b20 resolution, it's programmed on next bus scan and
+ *                  checked again on every rescan. Conversion time is 94ms at 9 bits and
+ *                  doubles for every more bit, up to 750ms at 12 bits
+ *	 input args:	
+ *					$serial : chipset serial number, NULL means every sensor
+ *					$bits   : resolution 9~12 bits, 0 means keep chip setting
+ * return value:    <0: failure   0: success
+ */
+extern int ds18b20SetResolution(const char *serial, int bits);
+
+
+/*	description:	init ds18b20 sensor registry, discover all sensors on w1 bus and
+ *                  keep their w1_slave files open
+ *	 input args:	
+ *					$path : w1 bus devices directory, NULL means /sys/bus/w1/devices/,
+ *                          point it to a tree built by tools/w1sim for simulation
+ * return value:    <0: failure   0: success
+ */
+extern int ds18b20Init(const char *path);
+
+
+/*	description:	terminate ds18b20 sensor registry */
+extern void ds18b20Term(void);
+
+
+/*	description:	get temperature from every ds18b20 in registry
+ *	 input args:	
+ *					$readings : readings output array
+ *					$max      : readings array size
+ * return value:    <0: failure   >=0: readings count
+ */
+extern int ds18b20GetTemperatures(ds18b20_reading_t *readings, int max);
+
+
+/*	description:	get the longest time ds18b20GetTemperatures() may block on sensors in
+ *                  registry, call it from the thread which owns the registry
+ *	 input args:	
+ *					$max      : readings array size
+ * return value:    milliseconds
+ */
+extern int ds18b20CollectMs(int max);
 
 #endif
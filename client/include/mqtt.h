@@ -14,41 +14,96 @@
 #ifndef _MQTT_H_
 #define _MQTT_H_
 
+#include <stdint.h>
 #include <mosquitto.h>
 #include "readconf.h"
 
-/*	description:	init mosquitto mqtt
+/*	description:	init mosquitto mqtt and create the client instance used during whole program
  *	 input args:	
- *					$mosq  : mosquitto mqtt pointer
+ *					$conf  : client configurations
  * return value:    <0: failure   0: success
  */
-extern int mqttInit(struct mosquitto *mosq);
+extern int mqttInit(conf_t *conf);
+
+
+/*	description:	disconnect from broker and destroy mosquitto mqtt client instance */
+extern void mqttTerm(void);
+
+
+/*	description:	start asynchronous connection to broker when it's not connected and backoff time
+ *                  is up. socket is connecting in background, mqttLoop() completes connection.
+ * return value:    <0: failure   0: new socket is opened   1: nothing to do now
+ */
+extern int mqttConnect(void);
+
+
+/*	description:	check mosquitto mqtt client connected to broker
+ * return value:    1: connected   0: not connected
+ */
+extern int mqttConnected(void);
+
+
+/*	description:	get mosquitto mqtt client socket, caller waits on it in event loop
+ * return value:    <0: no socket   >=0: socket
+ */
+extern int mqttSocket(void);
+
+
+/*	description:	check mosquitto mqtt client has data waiting to be written
+ * return value:    1: wait socket writable   0: no data to write
+ */
+extern int mqttWantWrite(void);
 
 
-/*	description:	terminate mosquitto mqtt
+/*	description:	handle socket events and periodic work(keepalive, retry) of mosquitto mqtt client
  *	 input args:	
- *					$mosq  : mosquitto mqtt pointer
- * return value:    <0: failure   0: success
+ *					$readable : socket readable
+ *					$writable : socket writable
+ * return value:    <0: connection lost   0: success
  */
-extern int mqttTerm(struct mosquitto *mosq);
+extern int mqttLoop(int readable, int writable);
 
 
-/*	description:	mosquitto mqtt client connect to broker
+/*	description:	get free slots in publish window
+ * return value:    free slots, 0 when not connected
+ */
+extern int mqttInflightFree(void);
+
+
+/*	description:	get free slots in publish window for messages from database, part of window
+ *                  is always left for live messages
+ * return value:    free slots, 0 when not connected
+ */
+extern int mqttStoredFree(void);
+
+
+/*	description:	get messages from database in publish window
+ * return value:    messages waiting for acknowledge
+ */
+extern int mqttStoredInflight(void);
+
+
+/*	description:	mosquitto mqtt client publish live message to broker, message stays in publish
+ *                  window until broker acknowledges it
  *	 input args:	
- *					$mosq  : mosquitto mqtt pointer
- *					$conf  : client configurations
+ *					$data   : packeted data
+ *					$bytes  : data total bytes
+ *					$record : samples record of message, saved in database when connection lost
+ *					$size   : samples record bytes
  * return value:    <0: failure   0: success
  */
-extern int mqttConnect(struct mosquitto *mosq, conf_t *conf);
+extern int mqttPublish(char *data, int bytes, char *record, int size);
 
 
-/*	description:	mosquitto mqtt client publish data to broker
+/*	description:	mosquitto mqtt client publish message packeted from database records to broker,
+ *                  records are removed when broker acknowledges it
  *	 input args:	
- *					$mosq  : mosquitto mqtt pointer
- *					$data  : packeted data(JSON)
+ *					$data  : packeted data
  *					$bytes : data total bytes
+ *					$ids   : database record ids
+ *					$count : database record ids count
  * return value:    <0: failure   0: success
  */
-extern int mqttPublish(struct mosquitto *mosq, char *data, int bytes);
+extern int mqttPublishStored(char *data, int bytes, int64_t *ids, int count);
 
 #endif
@@ -16,31 +16,42 @@
 
 #include <stdint.h>
 #include <time.h>
+#include "ds18b20.h"
 
 #define DEVID_LEN          16
 #define TIME_LEN           32
+#define PACK_MAX_SENSORS   64
+#define PACK_BUF_LEN       16384
+#define PACK_CBOR_VERSION  1
+#define PACK_TS_MAGIC      "TS"
+#define PACK_TS_VERSION    1
+#define PACK_TS_MAX_SAMPLES 64
 
 typedef struct pack_info_s
 {
-    char		devid[DEVID_LEN];       // device ID
-    char		sample_time[TIME_LEN];  // sample time
-    float       temper;                 // sample temperature
+    char		        devid[DEVID_LEN];               // device ID
+    char		        sample_time[TIME_LEN];          // sample time
+    int64_t             sample_ms;                      // sample time, epoch milliseconds
+    int                 count;                          // sensor readings count
+    ds18b20_reading_t   reading[PACK_MAX_SENSORS];      // sensor readings
 } pack_info_t;
 
 // packet function pointer type
-typedef int (*packFunc)(pack_info_t *pack_info, char *pack_buf, int size, int platform);
+typedef int (*packFunc)(pack_info_t *pack_info, char *pack_buf, int size);
 
+// batch packet function pointer type, packs count samples into one message
+typedef int (*packBatchFunc)(pack_info_t *pack_info, int count, char *pack_buf, int size);
 
-/*	description:	get sample time
+
+/*	description:	choose packet templates of broker platform, called once at config time
  *	 input args:	
- *					$sample_time : time information buffer
- *					$size        : buffer size
+ *					$platform : broker platform, 1 means HW, 2 means AL, 3 means TX
  * return value:    <0: failure   0: success
  */
-extern int getTime(char *sample_time, int size);
+extern int packetInit(int platform);
 
 
-/*	description:	packet segment data into text, include device ID, sample time, sample temper
+/*	description:	packet segment data into text, include device ID, sample time, every sensor temper
  *	 input args:	
  *					$pack_info : struct whitch store segment data
  *                  $pack_buf  : buffer whitch will store packeted data
@@ -50,14 +61,122 @@ extern int getTime(char *sample_time, int size);
 extern int packetSegmentData(pack_info_t *pack_info, char *pack_buf, int size);
 
 
-/*	description:	packet segment data into json, include device ID, sample time, sample temper
+/*	description:	packet segment data into json, include every sensor temper, first sensor
+ *                  temper is also reported as "temperature" for single probe boards
  *	 input args:	
  *					$pack_info : struct whitch store segment data
  *                  $pack_buf  : buffer whitch will store packeted data
  *                  $size      : buffer size 
  * return value:    <0: failure   >0: success
  */
-extern int packetJsonData(pack_info_t *pack_info, char *pack_buf, int size, int platform);
+extern int packetJsonData(pack_info_t *pack_info, char *pack_buf, int size);
+
+
+/*	description:	packet samples into one json message in platform's multi-point form, Huawei
+ *                  services[] with event_time, Aliyun params properties with time, Tencent
+ *                  state.reported with samples[]. one sample is packeted by packetJsonData()
+ *	 input args:	
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+extern int packetJsonBatch(pack_info_t *pack_info, int count, char *pack_buf, int size);
+
+
+/*	description:	packet segment data into CBOR, same as one sample batch
+ *	 input args:	
+ *					$pack_info : struct whitch store segment data
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+extern int packetCborData(pack_info_t *pack_info, char *pack_buf, int size);
+
+
+/*	description:	packet samples into CBOR: [version, devid, sample...], every sample is
+ *                  [epoch ms, serial, milli-degrees, serial, milli-degrees...], serial is
+ *                  7 bytes family code and id, or text if it's not in w1 form
+ *	 input args:	
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+extern int packetCborBatch(pack_info_t *pack_info, int count, char *pack_buf, int size);
+
+
+/*	description:	decode CBOR packet from packetCborBatch(), for the consumer side
+ *	 input args:	
+ *                  $pack_buf  : CBOR packet
+ *                  $bytes     : CBOR packet bytes
+ *					$pack_info : samples output, sample_time is not filled
+ *					$max       : samples output buffer count
+ * return value:    <0: failure   >=0: samples decoded
+ */
+extern int packetCborDecode(const char *pack_buf, int bytes, pack_info_t *pack_info, int max);
 
 
+/*	description:	packet segment data into time series columns, same as one sample batch
+ *	 input args:	
+ *					$pack_info : struct whitch store segment data
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+extern int packetTsData(pack_info_t *pack_info, char *pack_buf, int size);
+
+
+/*	description:	packet samples into time series columns: "TS", version, devid, sensors
+ *                  table sorted by serial, samples count, delta of delta timestamps column,
+ *                  then one zigzag delta values column with presence bitmap per sensor
+ *	 input args:	
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count, most PACK_TS_MAX_SAMPLES
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+extern int packetTsBatch(pack_info_t *pack_info, int count, char *pack_buf, int size);
+
+
+/*	description:	decode time series packet from packetTsBatch(), for the consumer side
+ *	 input args:	
+ *                  $pack_buf  : time series packet
+ *                  $bytes     : time series packet bytes
+ *					$pack_info : samples output, sample_time is not filled
+ *					$max       : samples output buffer count
+ * return value:    <0: failure   >=0: samples decoded
+ */
+extern int packetTsDecode(const char *pack_buf, int bytes, pack_info_t *pack_info, int max);
+
+
+/*	description:	get time of first sample in time series packet, database keys stored
+ *                  packets on it so retention follows sample time instead of push time
+ *	 input args:	
+ *                  $pack_buf  : time series packet
+ *                  $bytes     : time series packet bytes
+ * return value:    0: not a time series packet   >0: first sample time, epoch milliseconds
+ */
+extern int64_t packetTsTime(const void *pack_buf, int bytes);
+
+
+/*	description:	thin samples of time series packet older than a time to first sample of
+ *                  every interval, for database retention
+ *	 input args:	
+ *                  $pack_buf  : time series packet
+ *                  $bytes     : time series packet bytes
+ *                  $before    : epoch milliseconds, samples since then are kept
+ *                  $interval  : milliseconds, first sample of every interval is kept, 0 means
+ *                               remove all samples before $before
+ *                  $bucket    : interval of last sample kept, it goes on from previous packet
+ *                  $thin_buf  : buffer whitch will store thinned packet
+ *                  $size      : buffer size
+ * return value:    <0: not a time series packet   0: no sample left
+ *                  $bytes: packet is kept as it is   others: thinned packet bytes in $thin_buf
+ */
+extern int packetTsThin(const void *pack_buf, int bytes, int64_t before, int64_t interval, int64_t *bucket, void *thin_buf, int size);
+
 #endif
@@ -15,12 +15,36 @@
 #ifndef _READ_CONF_H_
 #define _READ_CONF_H_
 
+#define CONF_MAX_RESOLUTION     32
+#define CONF_MAX_THIN           4
+
+// publish payload format
+enum {
+    CONF_FORMAT_JSON,
+    CONF_FORMAT_CBOR,
+    CONF_FORMAT_TS,
+};
+
+typedef struct conf_resolution_s {
+    char            serial[24];         // ds18b20 serial number
+    int             bits;               // ds18b20 resolution in bits
+}conf_resolution_t;
+
+typedef struct conf_thin_s {
+    int             age;                // packets older than age seconds are thinned
+    int             interval;           // one packet is kept every interval seconds
+}conf_thin_t;
+
 typedef struct conf_s {
 
 	/*device and hardware configurations*/
 	
     char            deviceid[16];       // device id
     int             ds18b20;            // ds18b20 = 1 means this hardware exist
+    char            w1path[128];        // w1 bus devices directory
+    int             resolution;         // ds18b20 resolution 9~12 bits, 0 means keep chip setting
+    int             nres;               // per sensor resolution count
+    conf_resolution_t res[CONF_MAX_RESOLUTION]; // per sensor resolution, key is resolution:<serial>
 
 	/*mosquitto mqtt broker configurations*/	
 	    
@@ -34,9 +58,31 @@ typedef struct conf_s {
 	/*mosquitto mqtt publisher configuations*/	
 	
     char            pubtopic[256];      // publish topic
+    char            histopic[256];      // publish topic of samples from database, empty means pubtopic
+    int             format;             // payload format, CONF_FORMAT_JSON, CONF_FORMAT_CBOR or CONF_FORMAT_TS
     int				qos;				// message QoS
     int				keepalive;			// TCP keepalive time
-    int             readtime;           // sample interval time
+    int             inflight;           // unacknowledged messages in flight, 0 means default
+    int             backfillwindow;     // most messages from database in flight, 0 means 3/4 of inflight
+    int             backfillrate;       // most bytes per second of messages from database, 0 means no limit
+    int             readtime;           // sample interval in milliseconds
+    int             batchcount;         // samples packeted into one message, 0 or 1 means no batching
+    int             batchbytes;         // batch message byte budget, 0 means packet buffer size
+    int             batchlinger;        // most milliseconds a sample waits in batch, 0 means no limit
+
+	/*spool database configurations*/
+
+    int             dbbackend;          // database storage backend, DATABASE_BACKEND_*
+    int             dbsync;             // database synchronous level, DATABASE_SYNC_*
+    int             dbcommitrows;       // packets committed together, 0 means default
+    int             dbcommittime;       // most milliseconds a packet waits for commit, 0 means default
+    int             dbringbytes;        // most packets bytes kept in memory before database file, 0 means default
+    int             dbringtime;         // most milliseconds a packet is kept in memory, 0 means default
+    long long       dbmaxrows;          // most packets stored, 0 means no limit
+    long long       dbmaxbytes;         // most packets bytes stored, 0 means no limit
+    int             dbmaxage;           // most seconds a packet is stored, 0 means no limit
+    int             nthin;              // thinning tiers count, 0 means default tiers
+    conf_thin_t     thin[CONF_MAX_THIN];// thinning tiers
     
 
 }conf_t;
@@ -0,0 +1,71 @@
+/********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  sampler.h
+ *    Description:  This file is a sampler thread function declare file.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 00时51分56秒"
+ *                 
+ ********************************************************************************/
+
+#ifndef  _SAMPLER_H_
+#define  _SAMPLER_H_
+
+#include "readconf.h"
+#include "packet.h"
+
+// samples buffered between sampler thread and publisher
+#define SAMPLER_QUEUE_LEN       64
+
+typedef struct sampler_stats_s
+{
+    unsigned long   samples;            // samples pushed into queue
+    unsigned long   failures;           // sample cycles without any reading
+    unsigned long   overruns;           // sample ticks missed because a cycle took too long
+    unsigned long   steps;              // wall clock steps the sample ticks were realigned to
+    unsigned long   dropped;            // oldest samples dropped when queue is full
+} sampler_stats_t;
+
+
+/*	description:	start sampler thread, it owns ds18b20 sensor registry and puts
+ *                  timestamped readings into a bounded queue every $conf->readtime ms,
+ *                  ticks are absolute monotonic deadlines phase aligned to wall clock
+ *	 input args:	
+ *					$conf : client configurations
+ * return value:    <0: failure   0: success
+ */
+extern int samplerStart(conf_t *conf);
+
+
+/*	description:	stop sampler thread and wait it exit, sample cycle in progress is waited
+ *                  for as long as it's ds18b20 collect deadline
+ * return value:    <0: sampler thread didn't exit in time   0: success
+ */
+extern int samplerStop(void);
+
+
+/*	description:	pop the oldest sample from queue, never blocks
+ *	 input args:	
+ *					$pack_info : sample output
+ * return value:    <0: queue is empty   0: success
+ */
+extern int samplerPop(pack_info_t *pack_info);
+
+
+/*	description:	get sampler statistics
+ *	 input args:	
+ *					$stats : statistics output
+ */
+extern void samplerGetStats(sampler_stats_t *stats);
+
+
+/*	description:	get sampler eventfd, it's readable when queue has samples. Read it to
+ *                  clear before popping samples
+ * return value:    <0: sampler not started   >=0: eventfd
+ */
+extern int samplerEventFd(void);
+
+#endif
@@ -0,0 +1,323 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  batch.c
+ *    Description:  This file is a sample batching function file. Samples are
+ *                  grouped into one MQTT message in platform's multi-point form,
+ *                  so each sample doesn't pay a whole PUBLISH and round-trip.
+ *                  Samples are saved in database as time series records, and
+ *                  records are packeted into messages when they are drained.
+ *                 
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时01分29秒"
+ *                 
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "batch.h"
+#include "logger.h"
+#include "clock.h"
+
+
+/* Use static global handler in order to simplify API,
+ * but it will make this library not thread safe
+ */
+static struct {
+    packBatchFunc       func;               // batch packet function
+    int                 max_count;          // samples in a full batch
+    int                 max_bytes;          // packeted batch byte budget
+    int                 linger;             // most milliseconds a sample waits, 0 means no limit
+    int                 count;              // pending samples
+    int64_t             first_ms;           // time the oldest pending sample added
+    pack_info_t         sample[BATCH_MAX_SAMPLES];
+    int                 record_bytes;       // samples record bytes of last packeted batch
+    char                record[PACK_BUF_LEN]; // samples record of last packeted batch
+    pack_info_t         stored[BATCH_MAX_SAMPLES]; // samples decoded from database records
+} batch;
+
+
+/*	description:	packet pending samples with byte budget
+ *	 input args:	
+ *					$count     : samples count
+ *                  $pack_buf  : buffer whitch will store packeted batch
+ *                  $size      : buffer size 
+ * return value:    <0: larger than byte budget   >0: packeted batch bytes
+ */
+static int batchPack(int count, char *pack_buf, int size) {
+
+    return batch.func(batch.sample, count, pack_buf, size < batch.max_bytes + 1 ? size : batch.max_bytes + 1);
+}
+
+
+/*	description:	keep samples record of packeted batch, it's saved in database when batch can't
+ *                  be published
+ *	 input args:	
+ *					$count     : samples count
+ */
+static void batchKeepRecord(int count) {
+
+    if( (batch.record_bytes = packetTsBatch(batch.sample, count, batch.record, sizeof(batch.record))) < 0 ) {
+        logError("packet samples record failure\n");
+        batch.record_bytes = 0;
+    }
+
+    return;
+}
+
+
+/*	description:	init batching stage between sampler and publisher, samples are grouped
+ *                  by $conf->batchcount, $conf->batchbytes and $conf->batchlinger
+ *	 input args:	
+ *					$conf : client configurations
+ *					$func : batch packet function
+ * return value:    <0: failure   0: success
+ */
+int batchInit(conf_t *conf, packBatchFunc func) {
+
+    // check input args
+    if( !conf || !func ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    batch.func = func;
+    batch.linger = conf->batchlinger > 0 ? conf->batchlinger : 0;
+
+    batch.max_count = conf->batchcount > 0 ? conf->batchcount : 1;
+    if( batch.max_count > BATCH_MAX_SAMPLES ) {
+        batch.max_count = BATCH_MAX_SAMPLES;
+    }
+
+    batch.max_bytes = conf->batchbytes > 0 ? conf->batchbytes : PACK_BUF_LEN - 1;
+    if( batch.max_bytes > PACK_BUF_LEN - 1 ) {
+        batch.max_bytes = PACK_BUF_LEN - 1;
+    }
+
+    logInfo("batch samples: count %d, bytes %d, linger %d ms\n", batch.max_count, batch.max_bytes, batch.linger);
+
+    return 0;
+}
+
+
+/*	description:	add one sample into batch, batch is packeted when it's full by count,
+ *                  or this sample makes it larger than byte budget. Sample that doesn't
+ *                  fit starts next batch
+ *	 input args:	
+ *					$pack_info : sample
+ *                  $pack_buf  : buffer whitch will store packeted batch
+ *                  $size      : buffer size 
+ * return value:    <0: failure   0: sample is pending in batch   >0: packeted batch bytes
+ */
+int batchAdd(pack_info_t *pack_info, char *pack_buf, int size) {
+
+    int             bytes = 0;
+
+    // check input args
+    if( !pack_info || !pack_buf || size <= 0 || !batch.func ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    if( !batch.count ) {
+        batch.first_ms = clockMonoMs();
+    }
+    memcpy(&batch.sample[batch.count++], pack_info, sizeof(*pack_info));
+
+    // packet every time, so the batch never grows over byte budget
+    if( (bytes = batchPack(batch.count, pack_buf, size)) > 0 ) {
+        if( batch.count < batch.max_count ) {
+            return 0;
+        }
+        batchKeepRecord(batch.count);
+        batch.count = 0;
+        return bytes;
+    }
+
+    // single sample is larger than byte budget
+    if( batch.count == 1 ) {
+        logError("sample packet is larger than batch bytes[%d], drop it\n", batch.max_bytes);
+        batch.count = 0;
+        return -2;
+    }
+
+    // send batch without this sample, it starts next batch
+    if( (bytes = batchPack(batch.count - 1, pack_buf, size)) < 0 ) {
+        batch.count = 0;
+        return -3;
+    }
+    batchKeepRecord(batch.count - 1);
+    memcpy(&batch.sample[0], &batch.sample[batch.count - 1], sizeof(batch.sample[0]));
+    batch.count = 1;
+    batch.first_ms = clockMonoMs();
+
+    return bytes;
+}
+
+
+/*	description:	packet pending samples now
+ *	 input args:	
+ *                  $pack_buf  : buffer whitch will store packeted batch
+ *                  $size      : buffer size 
+ * return value:    <0: failure   0: no pending sample   >0: packeted batch bytes
+ */
+int batchFlush(char *pack_buf, int size) {
+
+    int             bytes = 0;
+
+    // check input args
+    if( !pack_buf || size <= 0 ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    if( !batch.count ) {
+        return 0;
+    }
+
+    bytes = batchPack(batch.count, pack_buf, size);
+    batchKeepRecord(batch.count);
+    batch.count = 0;
+
+    return bytes;
+}
+
+
+/*	description:	get time until the oldest pending sample reaches linger time, so the
+ *                  event loop can sleep on it
+ * return value:    -1: no pending sample or no linger limit   >=0: milliseconds
+ */
+int batchTimeout(void) {
+
+    int64_t         left;
+
+    if( !batch.count || !batch.linger ) {
+        return -1;
+    }
+
+    left = batch.first_ms + batch.linger - clockMonoMs();
+
+    return left > 0 ? (int)left : 0;
+}
+
+
+/*	description:	get samples record of last packeted batch, it's saved in database instead of
+ *                  packeted batch, so saved samples are packeted again when they are drained
+ *	 input args:	
+ *					$record : output, samples record in batch
+ * return value:    0: no record   >0: samples record bytes
+ */
+int batchRecord(char **record) {
+
+    // check input args
+    if( !record ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    *record = batch.record;
+
+    return batch.record_bytes;
+}
+
+
+/*	description:	packet samples of database records into one message, records are taken in
+ *                  order while message is within BATCH_MAX_SAMPLES samples and byte budget, no
+ *                  linger is waited for saved samples. record is never split, so the message is
+ *                  acknowledged by removing it's records. record without samples record magic is
+ *                  saved by older version, it's sent as it is alone, and samples record which
+ *                  can't be decoded is broken, it's dropped
+ *	 input args:	
+ *					$packs     : database records, oldest first
+ *					$count     : database records count
+ *					$used      : output, database records packeted
+ *                  $pack_buf  : buffer whitch will store packeted message
+ *                  $size      : buffer size 
+ * return value:    <0: first record can't be packeted   >0: packeted message bytes
+ */
+int batchStored(database_pack_t *packs, int count, int *used, char *pack_buf, int size) {
+
+    int             ends[DATABASE_BATCH_MAX];
+    int             i;
+    int             n = 0;
+    int             m = 0;
+    int             lo, hi, mid;
+    int             rv = 0;
+    int             budget = size < batch.max_bytes + 1 ? size : batch.max_bytes + 1;
+
+    // check input args
+    if( !packs || count <= 0 || !used || !pack_buf || size <= 0 || !batch.func ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    // decode records first, ends[i] is samples count up to record i
+    for( i = 0; i < count && i < DATABASE_BATCH_MAX && n < BATCH_MAX_SAMPLES; i++ ) {
+
+        // record saved by older version goes alone
+        if( packs[i].bytes < (int)strlen(PACK_TS_MAGIC) || memcmp(packs[i].data, PACK_TS_MAGIC, strlen(PACK_TS_MAGIC)) ) {
+            if( i ) {
+                break;
+            }
+            if( packs[i].bytes > size ) {
+                logError("database record[%lld] is larger than packet buffer, drop it\n", (long long)packs[i].id);
+                return -2;
+            }
+            memcpy(pack_buf, packs[i].data, packs[i].bytes);
+            *used = 1;
+            return packs[i].bytes;
+        }
+
+        // broken record is dropped when it comes first
+        if( (m = packetTsDecode(packs[i].data, packs[i].bytes, &batch.stored[n], BATCH_MAX_SAMPLES - n)) <= 0 ) {
+            if( i ) {
+                break;
+            }
+            logError("database record[%lld] is a broken samples record, errcode = %d, drop it\n", (long long)packs[i].id, m);
+            return -3;
+        }
+
+        // record filling samples buffer may be cut, it starts next message
+        if( i && n + m == BATCH_MAX_SAMPLES ) {
+            break;
+        }
+        n += m;
+        ends[i] = n;
+    }
+
+    // all records fit in byte budget mostly, they are packeted once
+    if( (rv = batch.func(batch.stored, n, pack_buf, budget)) > 0 ) {
+        *used = i;
+        return rv;
+    }
+
+    // first record alone is larger than byte budget, it's packeted in whole buffer
+    if( i == 1 || batch.func(batch.stored, ends[0], pack_buf, budget) < 0 ) {
+        if( (rv = batch.func(batch.stored, ends[0], pack_buf, size)) < 0 ) {
+            logError("database record[%lld] can't be packeted, drop it\n", (long long)packs[0].id);
+            return -4;
+        }
+        *used = 1;
+        return rv;
+    }
+
+    // bisect most records within byte budget, lo records fit and hi records don't
+    for( lo = 1, hi = i; hi - lo > 1; ) {
+        mid = (lo + hi) / 2;
+        if( batch.func(batch.stored, ends[mid - 1], pack_buf, budget) > 0 ) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    *used = lo;
+
+    // packet buffer is overwritten by the last try
+    return batch.func(batch.stored, ends[lo - 1], pack_buf, budget);
+}
@@ -19,18 +19,38 @@
 #include <libgen.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
 
 #include "readconf.h"
 #include "logger.h"
 #include "process.h"
 #include "database.h"
+#include "clock.h"
 #include "ds18b20.h"
 #include "packet.h"
 #include "mqtt.h"
+#include "sampler.h"
+#include "batch.h"
 
 #define PROG_VERSION               	"v1.0.0"
 #define DAEMON_PIDFILE             	"/tmp/.client_mqttd.pid"
 
+// event loop housekeeping tick while disconnected: reconnect backoff and connect timeout, in milliseconds
+#define LOOP_TICK_MS               	1000
+#define MAX_EVENTS                 	8
+
+/* backfill rate limit: token bucket in bytes, a message from database is sent when bucket has tokens,
+ * and it's bytes are taken away, bucket holds at most one second of tokens
+ */
+static struct {
+    int                     rate;           // bytes per second, 0 means no limit
+    int64_t                 tokens;         // bytes may be sent now, negative after a large message
+    int64_t                 last_ms;        // time tokens were added last time
+} backfill;
+
 // print help information
 static void printUsage(char *progname) {
 
@@ -44,13 +64,221 @@ static void printUsage(char *progname) {
     return;
 }
 
-int checkSampleTime(time_t *last_time, int interval);
+/*	description:	set period of a monotonic timerfd, first expiry is one period later
+ *	 input args:	
+ *					$fd       : timerfd
+ *					$interval : timer interval in milliseconds
+ * return value:    <0: failure   0: success
+ */
+static int loopTimerSet(int fd, int interval) {
+
+    struct itimerspec       its = {{0}};
+
+    its.it_value.tv_sec = its.it_interval.tv_sec = interval / 1000;
+    its.it_value.tv_nsec = its.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+
+    return timerfd_settime(fd, 0, &its, NULL);
+}
+
+
+/*	description:	add fd into epoll, or modify it's events if already added
+ *	 input args:	
+ *					$epfd   : epoll fd
+ *					$fd     : fd to watch
+ *					$events : epoll events
+ * return value:    <0: failure   0: success
+ */
+static int loopWatch(int epfd, int fd, unsigned int events) {
+
+    struct epoll_event      ev = {0};
+
+    ev.events = events;
+    ev.data.fd = fd;
+    if( epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) < 0 && epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0 ) {
+        logError("epoll watch fd[%d] failure: %s\n", fd, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*	description:	keep mosquitto mqtt socket in epoll in sync with client state, socket
+ *                  changes on reconnect and waits writable only when data is queued
+ *	 input args:	
+ *					$epfd     : epoll fd
+ *					$mosq_fd  : mqtt socket in epoll now, -1 means none
+ *					$mosq_out : 1 means mqtt socket is watched for writable
+ */
+static void loopWatchMqtt(int epfd, int *mosq_fd, int *mosq_out) {
+
+    int                     fd = mqttSocket();
+    int                     out = mqttWantWrite();
+
+    if( fd == *mosq_fd && (fd < 0 || out == *mosq_out) ) {
+        return;
+    }
+
+    // socket closed by mosquitto is removed from epoll automatically
+    if( *mosq_fd >= 0 && fd != *mosq_fd ) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, *mosq_fd, NULL);
+    }
+
+    *mosq_fd = fd;
+    *mosq_out = out;
+    if( fd >= 0 ) {
+        loopWatch(epfd, fd, EPOLLIN | (out ? EPOLLOUT : 0));
+    }
+
+    return;
+}
+
+
+/*	description:	add backfill tokens for time passed since last time
+ * return value:    1: messages from database may be sent now   0: wait for tokens
+ */
+static int loopBackfillReady(void) {
+
+    int64_t         now = clockMonoMs();
+    int64_t         add;
+
+    if( !backfill.rate ) {
+        return 1;
+    }
+
+    // time of less than one token is kept for next time
+    add = (now - backfill.last_ms) * backfill.rate / 1000;
+    if( add > 0 ) {
+        backfill.tokens = backfill.tokens + add < backfill.rate ? backfill.tokens + add : backfill.rate;
+        backfill.last_ms = now;
+    }
+
+    return backfill.tokens > 0;
+}
+
+
+/*	description:	get time until backfill bucket has tokens again
+ * return value:    -1: no time limit   >=0: milliseconds
+ */
+static int loopBackfillTimeout(void) {
+
+    if( loopBackfillReady() ) {
+        return -1;
+    }
+
+    return (int)((1 - backfill.tokens) * 1000 / backfill.rate) + 1;
+}
+
+
+/*	description:	get time the event loop can sleep, until batch linger time, database spill/commit
+ *                  time, or backfill tokens when database packets wait
+ *	 input args:	
+ *					$backlog : database packets wait to be sent
+ * return value:    -1: no time limit   >=0: milliseconds
+ */
+static int loopTimeout(int backlog) {
+
+    int         timeout = batchTimeout();
+    int         spool = databaseTimeout();
+    int         refill = (backlog && mqttStoredFree() > 0) ? loopBackfillTimeout() : -1;
+
+    if( spool >= 0 && (timeout < 0 || spool < timeout) ) {
+        timeout = spool;
+    }
+    if( refill >= 0 && (timeout < 0 || refill < timeout) ) {
+        timeout = refill;
+    }
+
+    return timeout;
+}
+
+
+/*	description:	publish a packeted batch to broker, or save it's samples record in database if
+ *                  it can't be sent now
+ *	 input args:	
+ *					$pack_buf   : packeted data
+ *					$pack_bytes : packeted data bytes
+ * return value:    0: published   1: saved in database
+ */
+static int loopPublish(char *pack_buf, int pack_bytes) {
+
+    char        *record = NULL;
+    int         record_bytes = batchRecord(&record);
+
+    logDebug("mosquitto mqtt publish sample packet bytes[%d]\n", pack_bytes);
+    if( mqttPublish(pack_buf, pack_bytes, record, record_bytes) < 0 ) {
+        logWarn("mosquitto mqtt publish sample packet failure, save it in database now\n");
+        if( record_bytes > 0 ) {
+            databasePushPacket(record, record_bytes);
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/*	description:	fill backfill part of publish window with messages packeted from database records
+ *                  as backfill rate allows, records are removed when broker acknowledges the message
+ *	 input args:	
+ *					$cursor : record id of last published record
+ * return value:    <0: failure   0: no record left   >0: publish window is full or rate limit is reached
+ */
+static int loopDrain(int64_t *cursor) {
+
+    static char             drain_buf[PACK_BUF_LEN * 4];
+    static char             pack_buf[PACK_BUF_LEN];
+    database_pack_t         drain_packs[DATABASE_BATCH_MAX];
+    int64_t                 ids[DATABASE_BATCH_MAX];
+    int                     drain_count = 0;
+    int                     pack_bytes = 0;
+    int                     used = 0;
+    int                     i;
+
+    while( mqttStoredFree() > 0 && loopBackfillReady() ) {
+        drain_count = databasePopPackets(*cursor, drain_packs, DATABASE_BATCH_MAX, drain_buf, sizeof(drain_buf));
+
+        /* nothing after cursor, but a record may still sit at or below it. Once no
+         * database message is in flight every record left must go again, start over
+         */
+        if( !drain_count && *cursor && !mqttStoredInflight() ) {
+            *cursor = 0;
+            continue;
+        }
+        if( drain_count <= 0 ) {
+            return drain_count;
+        }
+
+        // record which can't be packeted never goes, it's removed
+        if( (pack_bytes = batchStored(drain_packs, drain_count, &used, pack_buf, sizeof(pack_buf))) < 0 ) {
+            logWarn("remove database record[%lld] which can't be packeted, errcode = %d\n", (long long)drain_packs[0].id, pack_bytes);
+            databaseDelPacket(drain_packs[0].id);
+            *cursor = drain_packs[0].id;
+            continue;
+        }
+
+        for( i = 0; i < used; i++ ) {
+            ids[i] = drain_packs[i].id;
+        }
+        logDebug("mosquitto mqtt publish %d database records from [%lld] bytes[%d]\n", used, (long long)ids[0], pack_bytes);
+        if( mqttPublishStored(pack_buf, pack_bytes, ids, used) < 0 ) {
+            logError("mosquitto mqtt publish database records failure\n");
+            return -1;
+        }
+        *cursor = ids[used - 1];
+        backfill.tokens -= pack_bytes;
+    }
+
+    return 1;
+}
+
 
 int main(int argc, char* argv[]) {
 
 	extern proc_signal_t	g_signal;
 	int						daemon = 1;
 	int						rv = -1;
+	int						i;
 	
 	char                    *progname = NULL;
 	
@@ -62,16 +290,27 @@ int main(int argc, char* argv[]) {
 	
 	char					*confile = "./client.conf";
 	conf_t					cli_conf = {0};
+	database_opt_t			db_opt = {0};
 
-    time_t                  last_time = 0;
-    int                     sample_flag = 0;
-    
-    char                    pack_buf[1024] = {0};
+    char                    pack_buf[PACK_BUF_LEN] = {0};
     int                     pack_bytes = 0;
+    char                    *pack_record = NULL;
     pack_info_t             pack_info = {0};
-    packFunc             	pack_function = packetJsonData;
+    packBatchFunc           pack_function = packetJsonBatch;
     
-    struct mosquitto		*mosq = NULL;
+    int                     epfd = -1;
+    int                     signal_fd = -1;
+    int                     tick_fd = -1;
+    int                     mosq_fd = -1;
+    int                     mosq_out = 0;
+    int                     tick_slow = 0;
+    int                     backlog = 1;
+    int                     sampler_stuck = 0;
+    int64_t                 cursor = 0;
+    int                     nfds = 0;
+    uint64_t                value = 0;
+    struct signalfd_siginfo siginfo;
+    struct epoll_event      events[MAX_EVENTS];
 	
 	struct option           opts[] = {
                             {"debug", no_argument, NULL, 'd'},                  
@@ -106,7 +345,7 @@ int main(int argc, char* argv[]) {
     }
     
     // init log system
-    if( logInit(logfile, loglevel, logsize, LOG_LOCK_DISABLE) < 0 ) {
+    if( logInit(logfile, loglevel, logsize, LOG_LOCK_ENABLE) < 0 ) {
         fprintf(stderr, "Initial log system failure, program will exit\n");
         return -1;
     }
@@ -120,116 +359,205 @@ int main(int argc, char* argv[]) {
     	return -2;
     }
     
+    // reading configure from file: ./client.conf
+    if( (rv = readConf(confile, &cli_conf)) < 0 ) {
+    	logError("Read configurations from %s faliure, program will exit\n", confile);
+    	goto Cleanup;
+    }
+       
     // init database system
-    if( databaseInit(dbfile) < 0 ) {
+    db_opt.backend = cli_conf.dbbackend;
+    db_opt.sync = cli_conf.dbsync;
+    db_opt.commit_rows = cli_conf.dbcommitrows;
+    db_opt.commit_ms = cli_conf.dbcommittime;
+    db_opt.ring_bytes = cli_conf.dbringbytes;
+    db_opt.ring_ms = cli_conf.dbringtime;
+    db_opt.max_rows = cli_conf.dbmaxrows;
+    db_opt.max_bytes = cli_conf.dbmaxbytes;
+    db_opt.max_age = cli_conf.dbmaxage;
+    for( i = 0; i < cli_conf.nthin && i < DATABASE_THIN_MAX; i++ ) {
+        db_opt.thin[i].age = cli_conf.thin[i].age;
+        db_opt.thin[i].interval = cli_conf.thin[i].interval;
+    }
+    db_opt.nthin = i;
+    // samples records are kept and thinned by their samples time
+    db_opt.packet_time = packetTsTime;
+    db_opt.packet_thin = packetTsThin;
+    if( databaseInit(dbfile, &db_opt) < 0 ) {
         logError("Initial database system faliure, program will exit\n");
-        unlink(DAEMON_PIDFILE);
-    	logTerm();
-    	return -3;
+    	goto Cleanup;
+    }
+    
+    // if ds18b20 is not aviliable, then exit this program
+    if( cli_conf.ds18b20 != 1 ) {
+    	logError("ds18b20 is not aviliable, program will exit\n");
+    	goto Cleanup;
     }
     
     // init mosquitto mqtt system
-    if( mqttInit(mosq) < 0) {
+    if( mqttInit(&cli_conf) < 0) {
     	logError("Initial mosquitto mqtt system faliure, program will exit\n");
     	goto Cleanup;
     }
     
-    // reading configure from file: ./client.conf
-    if( (rv = readConf(confile, &cli_conf)) < 0 ) {
-    	logError("Read configurations from %s faliure, program will exit\n", confile);
+    // SIGINT and SIGTERM come from signalfd, block them before sampler thread starts
+    if( (signal_fd = installSignalFd()) < 0 ) {
+    	logError("Install signalfd faliure, program will exit\n");
     	goto Cleanup;
     }
-       
-    // if ds18b20 is not aviliable, then exit this program
-    if( cli_conf.ds18b20 != 1 ) {
-    	logError("ds18b20 is not aviliable, program will exit\n");
+    
+    // ds18b20 resolution will be programmed when sensor is found on w1 bus
+    ds18b20SetResolution(NULL, cli_conf.resolution);
+    for( i = 0; i < cli_conf.nres; i++ ) {
+    	ds18b20SetResolution(cli_conf.res[i].serial, cli_conf.res[i].bits);
+    }
+    
+    // binary payloads for our own broker, platform json for cloud
+    if( cli_conf.format == CONF_FORMAT_CBOR ) {
+    	pack_function = packetCborBatch;
+    }
+    else if( cli_conf.format == CONF_FORMAT_TS ) {
+    	pack_function = packetTsBatch;
+    }
+    
+    // samples saved in database go after live samples, at most at backfill rate
+    backfill.rate = cli_conf.backfillrate > 0 ? cli_conf.backfillrate : 0;
+    backfill.tokens = backfill.rate;
+    backfill.last_ms = clockMonoMs();
+    
+    // samples are grouped into one message before publishing
+    if( packetInit(cli_conf.platform) < 0 || batchInit(&cli_conf, pack_function) < 0 ) {
+    	logError("Initial batch faliure, program will exit\n");
+    	goto Cleanup;
+    }
+    
+    // sampler thread reads sensors, so slow conversion never stalls publishing
+    if( samplerStart(&cli_conf) < 0 ) {
+    	logError("Start sampler thread faliure, program will exit\n");
+    	goto Cleanup;
+    }
+    
+    // process sleeps in epoll until a signal, a sample, a housekeeping tick or mqtt socket event
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    tick_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if( epfd < 0 || tick_fd < 0 || loopTimerSet(tick_fd, LOOP_TICK_MS) < 0 ) {
+    	logError("Create event loop faliure, program will exit\n");
+    	goto Cleanup;
+    }
+    if( loopWatch(epfd, signal_fd, EPOLLIN) < 0 || loopWatch(epfd, samplerEventFd(), EPOLLIN) < 0 || loopWatch(epfd, tick_fd, EPOLLIN) < 0 ) {
     	goto Cleanup;
     }
     
     // continue running when g_signal.stop != 1
     while( !g_signal.stop ) {
     
-    	// set sample flag = 0
-    	sample_flag = 0;
-    	// if time interval = readtime, then read ds18b20 temper
-    	if( checkSampleTime(&last_time, cli_conf.readtime) ) {
-            logDebug("start sample DS18B20 termperature\n");
-
-            // read ds18b20 temper
-            if( (rv = ds18b20GetTemperature(&pack_info.temper)) < 0 ) {
-                logError("sample DS18B20 temperature failure, errcode = %d\n", rv);
-                continue;
-            }
-            logInfo("sample DS18B20 termperature success, temper = %.3f oC\n", pack_info.temper);
-
-            // get device id and sample time
-            strncpy(pack_info.devid, cli_conf.deviceid, sizeof(pack_info.devid));
-            getTime(pack_info.sample_time, TIME_LEN);
-
-            // pack data into JSON pakcet
-            pack_bytes = pack_function(&pack_info, pack_buf, sizeof(pack_buf), cli_conf.platform);
-            logDebug("packet sample data success, pack_buf = %s\n", pack_buf);
-            // set sample flag = 1
-            sample_flag = 1;
+        // sleep until an event, batch linger time, database spill/commit time or backfill tokens, publish window is refilled after broker acknowledges messages
+        nfds = epoll_wait(epfd, events, MAX_EVENTS, loopTimeout(backlog));
+        if( nfds < 0 && errno != EINTR ) {
+        	logError("epoll_wait() failure: %s\n", strerror(errno));
+        	break;
         }
         
-        // connect to broker
-        if( !mosq ) {
-        	rv = mqttConnect(mosq);
+        for( i = 0; i < nfds; i++ ) {
+        
+            // SIGINT or SIGTERM
+            if( events[i].data.fd == signal_fd ) {
+                while( read(signal_fd, &siginfo, sizeof(siginfo)) == sizeof(siginfo) ) {
+                    procDefaultSighandler(siginfo.ssi_signo);
+                }
+            }
+            
+            // housekeeping tick: connect to broker, or keep mqtt connection alive
+            else if( events[i].data.fd == tick_fd ) {
+                read(tick_fd, &value, sizeof(value));
+                // old socket left epoll when it was closed, new one may reuse it's number
+                if( !mqttConnect() ) {
+                    mosq_fd = -1;
+                }
+                mqttLoop(0, 0);
+                // give back space of delivered packets, all of it once backlog is drained
+                databaseVacuum(!backlog);
+            }
+            
+            // mosquitto mqtt socket
+            else if( events[i].data.fd == mosq_fd ) {
+                mqttLoop(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP), events[i].events & EPOLLOUT);
+            }
+            
+            // new samples in sampler queue
+            else if( events[i].data.fd == samplerEventFd() ) {
+                eventfd_read(samplerEventFd(), &value);
+                while( !samplerPop(&pack_info) ) {
+                
+                    // sample waits in batch until it's full
+                    if( (pack_bytes = batchAdd(&pack_info, pack_buf, sizeof(pack_buf))) < 0 ) {
+                        logError("packet sample data failure\n");
+                        continue;
+                    }
+                    if( pack_bytes > 0 && loopPublish(pack_buf, pack_bytes) ) {
+                        backlog = 1;
+                    }
+                }
+            }
         }
         
-        // if client disconnect, then push data into database
-        if( rv < 0 ) {
-        	if( sample_flag ) {
-        		databasePushPacket(pack_buf, pack_bytes);
-        	}
-        	continue;
+        // oldest sample in batch waited linger time
+        if( !batchTimeout() && (pack_bytes = batchFlush(pack_buf, sizeof(pack_buf))) > 0 && loopPublish(pack_buf, pack_bytes) ) {
+            backlog = 1;
         }
         
-        // if client connect, then publish data to broker
-        if( sample_flag ) {
-        	logDebug("mosquitto mqtt publish sample packet bytes[%d]: %s\n", pack_bytes, pack_buf);
-        	if( mqttPublish(mosq, pack_buf, pack_bytes) < 0 ) {
-                logWarn("mosquitto mqtt publish sample packet failure, save it in database now\n");
-                databasePushPacket(pack_buf, pack_bytes);
-                mqttTerm(mosq);
-            }
+        // packets saved in database are kept in memory for a while, and committed together when written to file
+        databaseFlush(0);
+        
+        // packets popped from database and live packets saved when connection lost are sent on next connection
+        if( !mqttConnected() ) {
+            cursor = 0;
+            backlog = 1;
         }
         
-        // mosquitto mqtt publish packet in database
-        if( !databasePopPacket(pack_buf, sizeof(pack_buf), &pack_bytes) ) {
-            logDebug("mosquitto mqtt publish database packet bytes[%d]: %s\n", pack_bytes, pack_buf);
-            if( mqttPublish(mosq, pack_buf, pack_bytes) < 0 ) {
-                logError("mosquitto mqtt publish database packet failure\n");
-                mqttTerm(mosq);
-            }
-            else {
-                logWarn("mosquitto mqtt publish database packet success, remove it from database now\n");
-                databaseDelPacket();
-            }
+        // live samples are published above, samples in database packeted in batch fill backfill part of
+        // publish window, they are removed when acknowledged
+        if( backlog && !loopDrain(&cursor) ) {
+            backlog = 0;
         }
         
-        msleep(50);
+        loopWatchMqtt(epfd, &mosq_fd, &mosq_out);
+        
+        // connected client only needs housekeeping twice per keepalive
+        if( mqttConnected() != tick_slow ) {
+            tick_slow = mqttConnected();
+            loopTimerSet(tick_fd, (tick_slow && cli_conf.keepalive > 1) ? cli_conf.keepalive * 500 : LOOP_TICK_MS);
+        }
     }
     
  Cleanup:
+    sampler_stuck = samplerStop() < 0;
+    // samples still in batch are kept in database
+    if( batchFlush(pack_buf, sizeof(pack_buf)) > 0 && (pack_bytes = batchRecord(&pack_record)) > 0 ) {
+        databasePushPacket(pack_record, pack_bytes);
+    }
+    mqttTerm();
   	mosquitto_lib_cleanup();
+  	if( epfd >= 0 ) {
+  		close(epfd);
+  	}
+  	if( tick_fd >= 0 ) {
+  		close(tick_fd);
+  	}
+  	if( signal_fd >= 0 ) {
+  		close(signal_fd);
+  	}
     databaseTerm();
     unlink(DAEMON_PIDFILE);
-    logTerm();
-
-    return 0;
-}
-
-int checkSampleTime(time_t *last_time, int interval) {
 
-    int                  flag = 0;
-    time_t               t = time(&t);
-      
-    if( t >= *last_time + interval ) {
-        flag = 1;
-        *last_time = t;
+    /* sampler thread stuck in a w1 read still uses logger and sensor registry when it
+     * comes back, so process exits right now instead of tearing them down under it
+     */
+    if( sampler_stuck ) {
+        logError("sampler thread is still reading w1 bus, exit without waiting it\n");
+        _exit(1);
     }
+    logTerm();
 
-    return flag;
+    return 0;
 }
@@ -30,80 +30,781 @@
 #include <string.h>
 #include <time.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/inotify.h>
 
+#include "ds18b20.h"
 #include "logger.h"
+#include "clock.h"
+#include "process.h"
 
-int ds18b20GetTemperature(float *temp) {
+// default w1 bus devices directory
+#define W1_DEVICES_PATH         "/sys/bus/w1/devices/"
 
-    int					rv = 0;
-    char                w1_path[64] = "/home/wmd/code/mysys/bus/w1/devices/";
-    char                chip[24] = {0};
-    char                buf[128] = {0};
+// ds18b20 family code prefix of device directory name
+#define DS18B20_FAMILY          "28-"
+
+/* sysfs dosen't always emit inotify events when slaves come and go,
+ * so rescan the bus anyway after this many seconds
+ */
+#define DS18B20_RESCAN_INTERVAL 60
+
+// w1 master bulk conversion trigger, start conversion on all slaves at once
+#define W1_BULK_READ            "w1_bus_master1/therm_bulk_read"
+
+// 12-bit conversion time, and the margin over conversion time to collect all readings
+#define DS18B20_CONV_MS         750
+#define DS18B20_DEADLINE_MARGIN 250
+
+// resolution settings kept for sensors not on the bus yet
+#define DS18B20_MAX_RESOLUTION  32
+
+// worker threads to read sensors when w1 master has no bulk trigger, kept across cycles
+#define DS18B20_WORKERS         32
+
+typedef struct ds18b20_sensor_s
+{
+    char        serial[DS18B20_SN_LEN];     // chipset serial number, 28-xxxxxxxxxxxx
+    int         fd;                         // w1_slave file descriptor, kept open
+    int         bits;                       // resolution in bits, 0 means unknown
+} ds18b20_sensor_t;
+
+typedef struct ds18b20_resolution_s
+{
+    char        serial[DS18B20_SN_LEN];     // chipset serial number
+    int         bits;                       // wanted resolution in bits
+} ds18b20_resolution_t;
+
+/* Use static global registry in order to simplify API,
+ * but it will make this library not thread safe
+ */
+static struct {
+    char                path[128];          // w1 bus devices directory
+    int                 inotify_fd;         // watch bus directory for hotplug
+    int                 bulk_fd;            // therm_bulk_read file descriptor, -1 means unsupported
+    int                 rescan;             // 1 means registry must be rebuilt
+    int                 conv_ms;            // conversion time of the slowest sensor
+    int                 bits;               // wanted resolution of every sensor, 0 means keep chip setting
+    int                 nres;               // per sensor resolution count
+    ds18b20_resolution_t res[DS18B20_MAX_RESOLUTION]; // per sensor resolution
+    time_t              scan_time;          // last time the bus was scanned
+    int                 count;              // sensors in registry
+    int                 capacity;           // sensor array capacity
+    ds18b20_sensor_t    *sensor;            // sensor array
+} w1_bus = { .inotify_fd = -1, .bulk_fd = -1, .conv_ms = DS18B20_CONV_MS };
+
+/* Worker pool kept alive across sample cycles. Each cycle is a queue of sensor
+ * jobs, a worker claims the next one and owns a dup of its fd until the read
+ * returns. A worker which misses the deadline finds a newer generation when it
+ * comes back and drops its stale reading, so it never writes into a later cycle
+ */
+static struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      work;               // signaled when a cycle starts or pool stops
+    pthread_cond_t      done;               // signaled when a job of current cycle finished
+    int                 stop;               // 1 means workers must exit
+    int                 threads;            // workers started
+    unsigned int        generation;         // current cycle number
+    int                 count;              // jobs in current cycle
+    int                 next;               // next job to claim
+    int                 pending;            // jobs of current cycle not finished yet
+    int                 capacity;           // job arrays capacity
+    int                 *fd;                // dup of each sensor w1_slave fd, -1 once claimed
+    int                 *mtemper;           // each sensor temperature in milli-degrees
+    int                 *status;            // 0: not read yet  1: success  <0: failure
+} w1_pool = { .lock = PTHREAD_MUTEX_INITIALIZER, .work = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER };
+
+
+/*	description:	close all sensors in registry */
+static void ds18b20Close(void) {
+
+    int         i;
+
+    for( i = 0; i < w1_bus.count; i++ ) {
+        if( w1_bus.sensor[i].fd >= 0 ) {
+            close(w1_bus.sensor[i].fd);
+        }
+    }
+    w1_bus.count = 0;
+
+    if( w1_bus.bulk_fd >= 0 ) {
+        close(w1_bus.bulk_fd);
+        w1_bus.bulk_fd = -1;
+    }
+
+    return;
+}
+
+
+/*	description:	compare two sensors by serial number, keep report order stable */
+static int ds18b20Compare(const void *a, const void *b) {
+
+    return strcmp(((const ds18b20_sensor_t *)a)->serial, ((const ds18b20_sensor_t *)b)->serial);
+}
+
+
+/*	description:	check sensor resolution through w1_therm sysfs attribute, program it
+ *                  if it's not what we want. The setting lives in scratchpad only and
+ *                  gets lost on power cycle, so it's checked again on every rescan
+ *	 input args:	
+ *					$sensor : sensor in registry
+ * return value:    sensor resolution in bits, 0 means unknown
+ */
+static int ds18b20CheckResolution(ds18b20_sensor_t *sensor) {
+
+    char                path[256] = {0};
+    char                buf[8] = {0};
+    int                 fd = -1;
+    int                 bits = 0;
+    int                 want = w1_bus.bits;
+    int                 i;
+
+    for( i = 0; i < w1_bus.nres; i++ ) {
+        if( !strcmp(w1_bus.res[i].serial, sensor->serial) ) {
+            want = w1_bus.res[i].bits;
+            break;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s%s/resolution", w1_bus.path, sensor->serial);
+    fd = open(path, want ? O_RDWR : O_RDONLY);
+
+    // not writable, e.g. not running as root, current resolution is still reported
+    if( fd < 0 && want && errno != ENOENT ) {
+        logError("open %s for writing failure: %s, resolution %d bits is not set\n", path, strerror(errno), want);
+        want = 0;
+        fd = open(path, O_RDONLY);
+    }
+    if( fd < 0 ) {
+        // older kernel has no resolution attribute
+        if( errno != ENOENT ) {
+            logError("open %s failure: %s\n", path, strerror(errno));
+        }
+        return 0;
+    }
+
+    if( pread(fd, buf, sizeof(buf) - 1, 0) > 0 ) {
+        bits = atoi(buf);
+    }
+
+    if( want && bits != want ) {
+        snprintf(buf, sizeof(buf), "%d\n", want);
+        if( pwrite(fd, buf, strlen(buf), 0) < 0 ) {
+            logError("set sensor %s resolution %d bits failure: %s\n", sensor->serial, want, strerror(errno));
+        }
+        else {
+            logInfo("set sensor %s resolution %d -> %d bits\n", sensor->serial, bits, want);
+        }
+
+        // read back, the chip may reject it
+        memset(buf, 0, sizeof(buf));
+        bits = pread(fd, buf, sizeof(buf) - 1, 0) > 0 ? atoi(buf) : 0;
+        if( bits != want ) {
+            logWarn("sensor %s resolution is %d bits, not %d bits\n", sensor->serial, bits, want);
+        }
+    }
+    close(fd);
+
+    return (bits >= 9 && bits <= 12) ? bits : 0;
+}
+
+
+/*	description:	scan w1 bus, open every ds18b20 w1_slave file and keep it in registry
+ * return value:    <0: failure   >=0: sensors found
+ */
+static int ds18b20Scan(void) {
+
+    char                w1_path[256] = {0};
     DIR                 *dirp = NULL;
     struct dirent       *direntp = NULL;
+    ds18b20_sensor_t    *sensor = NULL;
     int                 fd = -1;
-    char                *ptr = NULL;
-    int                 found = 0;
+    int                 bits;
+    int                 i;
 
-    // check input args
-    if( !temp ) {
-    	return -1;
-    }
+    ds18b20Close();
+    w1_bus.rescan = 0;
+    w1_bus.scan_time = time(NULL);
 
     // open dierectory /sys/bus/w1/devices to get chipset serial number
-    if( !(dirp = opendir(w1_path)) ) {
+    if( !(dirp = opendir(w1_bus.path)) ) {
         logError("opendir faliure: %s\n", strerror(errno));
-        return -2;
+        w1_bus.rescan = 1;
+        return -1;
     }
 
     while( NULL != (direntp = readdir(dirp)) ) {
-        if(strstr(direntp->d_name, "28-")) {
-            // find and get the chipset sn filename
-            memset(chip, 0, sizeof(chip));
-            strcpy(chip, direntp->d_name);
-            found = 1;
-            break;
+        if( strncmp(direntp->d_name, DS18B20_FAMILY, strlen(DS18B20_FAMILY)) ) {
+            continue;
         }
+
+        // open file /sys/bus/w1/devices/28-xxxx/w1_slave and keep it open, cut path is never opened
+        if( snprintf(w1_path, sizeof(w1_path), "%s%s/w1_slave", w1_bus.path, direntp->d_name) >= (int)sizeof(w1_path) ) {
+            logError("w1_slave path of %s in %s is too long, skip it\n", direntp->d_name, w1_bus.path);
+            continue;
+        }
+        if( (fd = open(w1_path, O_RDONLY | O_CLOEXEC)) < 0 ) {
+            logError("open file %s failure: %s\n", w1_path, strerror(errno));
+            continue;
+        }
+
+        // grow registry if necessary
+        if( w1_bus.count == w1_bus.capacity ) {
+            sensor = realloc(w1_bus.sensor, (w1_bus.capacity + 8) * sizeof(*sensor));
+            if( !sensor ) {
+                logError("realloc sensor registry failure\n");
+                close(fd);
+                break;
+            }
+            w1_bus.sensor = sensor;
+            w1_bus.capacity += 8;
+        }
+
+        sensor = &w1_bus.sensor[w1_bus.count++];
+        strncpy(sensor->serial, direntp->d_name, sizeof(sensor->serial) - 1);
+        sensor->serial[sizeof(sensor->serial) - 1] = '\0';
+        sensor->fd = fd;
+        sensor->bits = ds18b20CheckResolution(sensor);
+        logInfo("found ds18b20 sensor %s, resolution %d bits\n", sensor->serial, sensor->bits);
     }
     // close dir
     closedir(dirp);
 
-    if( !found ) {
-        logError("can not find ds18b20 in %s\n", w1_path);
+    if( !w1_bus.count ) {
+        logError("can not find ds18b20 in %s\n", w1_bus.path);
+    }
+    qsort(w1_bus.sensor, w1_bus.count, sizeof(*w1_bus.sensor), ds18b20Compare);
+
+    // conversion time halves for every bit less, 12 bits is 750ms, 9 bits is 94ms
+    w1_bus.conv_ms = 0;
+    for( i = 0; i < w1_bus.count; i++ ) {
+        bits = w1_bus.sensor[i].bits ? w1_bus.sensor[i].bits : 12;
+        if( w1_bus.conv_ms < (DS18B20_CONV_MS >> (12 - bits)) + 1 ) {
+            w1_bus.conv_ms = (DS18B20_CONV_MS >> (12 - bits)) + 1;
+        }
+    }
+
+    // open w1 master bulk conversion trigger if kernel supports it
+    snprintf(w1_path, sizeof(w1_path), "%s%s", w1_bus.path, W1_BULK_READ);
+    if( (w1_bus.bulk_fd = open(w1_path, O_RDWR | O_CLOEXEC)) < 0 ) {
+        logDebug("w1 master has no bulk read, sensors will be read by worker threads\n");
+    }
+
+    return w1_bus.count;
+}
+
+
+/*	description:	drain hotplug events on w1 bus directory and mark registry for rescan */
+static void ds18b20CheckHotplug(void) {
+
+    char        buf[1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    if( w1_bus.inotify_fd >= 0 ) {
+        while( read(w1_bus.inotify_fd, buf, sizeof(buf)) > 0 ) {
+            w1_bus.rescan = 1;
+        }
+    }
+
+    if( time(NULL) >= w1_bus.scan_time + DS18B20_RESCAN_INTERVAL ) {
+        w1_bus.rescan = 1;
+    }
+
+    return;
+}
+
+
+/*	description:	drop unclaimed jobs of current cycle, must be called with lock held */
+static void ds18b20PoolAbandon(void) {
+
+    int                 i;
+
+    for( i = w1_pool.next; i < w1_pool.count; i++ ) {
+        if( w1_pool.fd[i] >= 0 ) {
+            close(w1_pool.fd[i]);
+            w1_pool.fd[i] = -1;
+        }
+    }
+    w1_pool.next = w1_pool.count;
+
+    return;
+}
+
+
+/*	description:	stop worker pool, workers blocked in a read exit when it returns */
+static void ds18b20PoolStop(void) {
+
+    pthread_mutex_lock(&w1_pool.lock);
+    ds18b20PoolAbandon();
+    w1_pool.stop = 1;
+    w1_pool.generation++;
+    w1_pool.count = w1_pool.next = w1_pool.pending = 0;
+    pthread_cond_broadcast(&w1_pool.work);
+
+    free(w1_pool.fd);
+    free(w1_pool.mtemper);
+    free(w1_pool.status);
+    w1_pool.fd = w1_pool.mtemper = w1_pool.status = NULL;
+    w1_pool.capacity = 0;
+    pthread_mutex_unlock(&w1_pool.lock);
+
+    return;
+}
+
+
+/*	description:	set wanted ds18b20 resolution, it's programmed on next bus scan
+ *	 input args:	
+ *					$serial : chipset serial number, NULL means every sensor
+ *					$bits   : resolution 9~12 bits, 0 means keep chip setting
+ * return value:    <0: failure   0: success
+ */
+int ds18b20SetResolution(const char *serial, int bits) {
+
+    int                 i;
+
+    // check input args
+    if( bits && (bits < 9 || bits > 12) ) {
+        logError("invalid ds18b20 resolution %d bits\n", bits);
+        return -1;
+    }
+
+    if( !serial ) {
+        w1_bus.bits = bits;
+        w1_bus.rescan = 1;
+        return 0;
+    }
+
+    for( i = 0; i < w1_bus.nres; i++ ) {
+        if( !strcmp(w1_bus.res[i].serial, serial) ) {
+            break;
+        }
+    }
+    if( i == DS18B20_MAX_RESOLUTION ) {
+        logError("too many ds18b20 resolution settings\n");
+        return -2;
+    }
+    if( i == w1_bus.nres ) {
+        strncpy(w1_bus.res[i].serial, serial, sizeof(w1_bus.res[i].serial) - 1);
+        w1_bus.nres++;
+    }
+    w1_bus.res[i].bits = bits;
+    w1_bus.rescan = 1;
+
+    return 0;
+}
+
+
+/*	description:	init ds18b20 sensor registry, discover all sensors on w1 bus
+ *	 input args:	
+ *					$path : w1 bus devices directory, NULL means /sys/bus/w1/devices/
+ * return value:    <0: failure   0: success
+ */
+int ds18b20Init(const char *path) {
+
+    int                 len;
+
+    if( !path || !strlen(path) ) {
+        path = W1_DEVICES_PATH;
+    }
+
+    // keep a trailing '/', sensor file path is built by appending to it
+    len = snprintf(w1_bus.path, sizeof(w1_bus.path) - 1, "%s", path);
+    if( len > 0 && len < (int)sizeof(w1_bus.path) - 1 && w1_bus.path[len - 1] != '/' ) {
+        w1_bus.path[len] = '/';
+    }
+
+    // watch bus directory, new or removed slave will trigger a rescan
+    w1_bus.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if( w1_bus.inotify_fd < 0 ) {
+        logWarn("inotify_init1() failure: %s\n", strerror(errno));
+    }
+    else if( inotify_add_watch(w1_bus.inotify_fd, w1_bus.path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) < 0 ) {
+        logWarn("watch %s failure: %s\n", w1_bus.path, strerror(errno));
+    }
+
+    if( ds18b20Scan() < 0 ) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*	description:	terminate ds18b20 sensor registry */
+void ds18b20Term(void) {
+
+    ds18b20PoolStop();
+    ds18b20Close();
+
+    free(w1_bus.sensor);
+    w1_bus.sensor = NULL;
+    w1_bus.capacity = 0;
+
+    if( w1_bus.inotify_fd >= 0 ) {
+        close(w1_bus.inotify_fd);
+        w1_bus.inotify_fd = -1;
+    }
+
+    return;
+}
+
+
+
+
+/*	description:	parse w1_slave file content in one pass, it looks like:
+ *
+ *                  72 01 4b 46 7f ff 0e 10 57 : crc=57 YES
+ *                  72 01 4b 46 7f ff 0e 10 57 t=23125
+ *
+ *	 input args:	
+ *					$buf     : w1_slave file content
+ *					$bytes   : content bytes
+ *					$mtemper : temperature output in milli-degrees Celsius
+ * return value:    <0: failure   0: success
+ */
+int ds18b20Parse(const char *buf, int bytes, int *mtemper) {
+
+    const char          *end = buf + bytes;
+    const char          *ptr = buf;
+    int                 value = 0;
+    int                 negative = 0;
+
+    // check input args
+    if( !buf || bytes <= 0 || !mtemper ) {
+        return -1;
+    }
+
+    // first line must end with crc check result "YES"
+    while( ptr < end && *ptr != '\n' ) {
+        ptr++;
+    }
+    if( ptr - buf < 3 || memcmp(ptr - 3, "YES", 3) ) {
+        return -2;
+    }
+
+    // temperature follows "t=" at the end of second line
+    for( ptr++; ptr + 1 < end; ptr++ ) {
+        if( ptr[0] == 't' && ptr[1] == '=' ) {
+            break;
+        }
+    }
+    if( ptr + 1 >= end ) {
         return -3;
     }
 
-    // get DS18B20 sample file full path /sys/bus/w1/devices/28-xxxx/w1_slave
-    strncat(w1_path, chip, sizeof(w1_path) - strlen(w1_path));
-    strncat(w1_path, "/w1_slave", sizeof(w1_path) - strlen(w1_path));
+    ptr += 2;
+    if( ptr < end && *ptr == '-' ) {
+        negative = 1;
+        ptr++;
+    }
+    if( ptr >= end || *ptr < '0' || *ptr > '9' ) {
+        return -3;
+    }
+    while( ptr < end && *ptr >= '0' && *ptr <= '9' && value < 1000000 ) {
+        value = value * 10 + (*ptr++ - '0');
+    }
 
-    // open file /sys/bus/w1/devices/28-xxxx/w1_slave to get temperature
-    if( (fd = open(w1_path, O_RDONLY)) < 0 ) {
-        logError("open file %s failure: %s\n", w1_path, strerror(errno));
+    // 85000 is power-on reset value of scratchpad, conversion didn't happen
+    if( !negative && value == 85000 ) {
         return -4;
     }
-	
-	// read file content
-    if( read(fd, buf, sizeof(buf)) < 0 ) {
-        logError("read data from file %s failure: %s\n", w1_path, strerror(errno));
-        rv = -5;
-        goto Cleanup;
-    }
-	
-	// find temper string in content
-    ptr = strstr(buf, "t=");
-    if( !ptr ) {
-        logError("get temperature failure\n");
-        rv = -6;
-        goto Cleanup;
-    }
-    
-	// convert string to float
-    ptr += 2;
-    *temp = atof(ptr) / 1000;
-	
- Cleanup:
- 	// close file
-    close(fd);
-    return rv;
+
+    *mtemper = negative ? -value : value;
+    return 0;
+}
+
+
+/*	description:	read temperature from w1_slave file
+ *	 input args:	
+ *					$fd      : w1_slave file descriptor
+ *					$mtemper : temperature output in milli-degrees Celsius
+ * return value:    -1: read failure   <-1: invalid content   0: success
+ */
+static int ds18b20ReadFd(int fd, int *mtemper) {
+
+    char                buf[128];
+    ssize_t             bytes;
+
+	// read file content from offset 0, sysfs will return a new conversion
+    if( (bytes = pread(fd, buf, sizeof(buf), 0)) <= 0 ) {
+        return -1;
+    }
+
+    return ds18b20Parse(buf, bytes, mtemper);
+}
+
+
+/*	description:	start conversion on all slaves through w1 master bulk trigger and wait
+ *                  until all of them finished or deadline passed
+ * return value:    <0: failure   0: success
+ */
+static int ds18b20BulkConvert(void) {
+
+    char                buf[16] = {0};
+    int64_t             deadline = clockMonoMs() + w1_bus.conv_ms + DS18B20_DEADLINE_MARGIN;
+
+    if( pwrite(w1_bus.bulk_fd, "trigger\n", 8, 0) < 0 ) {
+        logError("trigger w1 bulk conversion failure: %s\n", strerror(errno));
+        close(w1_bus.bulk_fd);
+        w1_bus.bulk_fd = -1;
+        return -1;
+    }
+
+    // nothing to do before conversion time passed
+    msleep(w1_bus.conv_ms);
+
+    // "-1" means still converting, "1" means done, "0" means nothing pending
+    while( clockMonoMs() < deadline ) {
+        memset(buf, 0, sizeof(buf));
+        if( pread(w1_bus.bulk_fd, buf, sizeof(buf) - 1, 0) <= 0 ) {
+            logError("read w1 bulk conversion state failure: %s\n", strerror(errno));
+            return -2;
+        }
+        if( buf[0] == '0' || buf[0] == '1' ) {
+            return 0;
+        }
+        msleep(10);
+    }
+
+    logWarn("w1 bulk conversion missed deadline %dms\n", w1_bus.conv_ms + DS18B20_DEADLINE_MARGIN);
+    return -3;
+}
+
+
+/*	description:	worker thread body, claim sensor jobs of current cycle until pool stops
+ *	 input args:	
+ *					$thread_arg : w1_pool, unused
+ */
+static void *ds18b20Worker(void *thread_arg) {
+
+    unsigned int        generation;
+    int                 mtemper = 0;
+    int                 fd;
+    int                 rv;
+    int                 i;
+
+    (void)thread_arg;
+
+    pthread_mutex_lock(&w1_pool.lock);
+    while( !w1_pool.stop ) {
+        if( w1_pool.next >= w1_pool.count ) {
+            pthread_cond_wait(&w1_pool.work, &w1_pool.lock);
+            continue;
+        }
+
+        // claim next job, the fd is ours until read returns
+        i = w1_pool.next++;
+        generation = w1_pool.generation;
+        fd = w1_pool.fd[i];
+        w1_pool.fd[i] = -1;
+        pthread_mutex_unlock(&w1_pool.lock);
+
+        rv = ds18b20ReadFd(fd, &mtemper);
+        close(fd);
+
+        pthread_mutex_lock(&w1_pool.lock);
+        // cycle already collected without us, drop stale reading
+        if( generation != w1_pool.generation ) {
+            continue;
+        }
+        w1_pool.mtemper[i] = mtemper;
+        w1_pool.status[i] = rv < 0 ? rv : 1;
+        if( --w1_pool.pending == 0 ) {
+            pthread_cond_signal(&w1_pool.done);
+        }
+    }
+    w1_pool.threads--;
+    pthread_mutex_unlock(&w1_pool.lock);
+
+    return NULL;
+}
+
+
+/*	description:	read $count sensors in parallel by worker pool, all conversions run at
+ *                  the same time, collect readings until deadline. Deadline grows with the
+ *                  rounds each worker needs when there are more sensors than workers
+ *	 input args:	
+ *					$readings : readings output array
+ *					$count    : sensors to read
+ * return value:    <0: failure   >=0: readings count
+ */
+static int ds18b20PoolRead(ds18b20_reading_t *readings, int count) {
+
+    pthread_t           tid;
+    struct timespec     deadline;
+    int                 deadline_ms;
+    int                 workers;
+    int                 *ptr;
+    int                 i;
+    int                 n = 0;
+
+    pthread_mutex_lock(&w1_pool.lock);
+    w1_pool.stop = 0;
+
+    // grow job arrays, jobs of last cycle were all abandoned or finished
+    if( count > w1_pool.capacity ) {
+        if( (ptr = realloc(w1_pool.fd, count * sizeof(int))) ) {
+            w1_pool.fd = ptr;
+        }
+        if( ptr && (ptr = realloc(w1_pool.mtemper, count * sizeof(int))) ) {
+            w1_pool.mtemper = ptr;
+        }
+        if( ptr && (ptr = realloc(w1_pool.status, count * sizeof(int))) ) {
+            w1_pool.status = ptr;
+        }
+        if( !ptr ) {
+            pthread_mutex_unlock(&w1_pool.lock);
+            logError("realloc ds18b20 worker jobs failure\n");
+            return -1;
+        }
+        w1_pool.capacity = count;
+    }
+
+    // start more workers if needed, they stay for next cycles
+    workers = count < DS18B20_WORKERS ? count : DS18B20_WORKERS;
+    while( w1_pool.threads < workers ) {
+        if( threadStart(&tid, ds18b20Worker, &w1_pool) ) {
+            logError("start ds18b20 worker thread failure\n");
+            break;
+        }
+        w1_pool.threads++;
+    }
+    if( !w1_pool.threads ) {
+        pthread_mutex_unlock(&w1_pool.lock);
+        return -2;
+    }
+
+    // workers own a dup of each fd, so a registry rescan can't close them underneath
+    for( i = 0; i < count; i++ ) {
+        w1_pool.fd[i] = dup(w1_bus.sensor[i].fd);
+        w1_pool.status[i] = 0;
+    }
+    w1_pool.generation++;
+    w1_pool.count = w1_pool.pending = count;
+    w1_pool.next = 0;
+    pthread_cond_broadcast(&w1_pool.work);
+
+    // every worker reads ceil(count / workers) sensors one after another
+    workers = w1_pool.threads < count ? w1_pool.threads : count;
+    deadline_ms = (count + workers - 1) / workers * w1_bus.conv_ms + DS18B20_DEADLINE_MARGIN;
+
+    // wait all jobs finished or deadline passed
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += deadline_ms / 1000;
+    deadline.tv_nsec += (deadline_ms % 1000) * 1000000L;
+    if( deadline.tv_nsec >= 1000000000L ) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    while( w1_pool.pending > 0 ) {
+        if( pthread_cond_timedwait(&w1_pool.done, &w1_pool.lock, &deadline) == ETIMEDOUT ) {
+            logWarn("%d ds18b20 readings missed deadline %dms\n", w1_pool.pending, deadline_ms);
+            break;
+        }
+    }
+    ds18b20PoolAbandon();
+
+    // collect readings finished in time
+    for( i = 0; i < count; i++ ) {
+        if( w1_pool.status[i] == 1 ) {
+            strncpy(readings[n].serial, w1_bus.sensor[i].serial, sizeof(readings[n].serial));
+            readings[n].mtemper = w1_pool.mtemper[i];
+            n++;
+        }
+        else if( w1_pool.status[i] < 0 ) {
+            logError("read data from sensor %s failure, errcode = %d\n", w1_bus.sensor[i].serial, w1_pool.status[i]);
+            // only a failed read means the sensor is gone, bad crc just drops this reading
+            if( w1_pool.status[i] == -1 ) {
+                w1_bus.rescan = 1;
+            }
+        }
+    }
+
+    // late workers must not write into this cycle any more
+    w1_pool.generation++;
+    w1_pool.count = w1_pool.next = w1_pool.pending = 0;
+    pthread_mutex_unlock(&w1_pool.lock);
+
+    return n;
+}
+
+
+/*	description:	get temperature from every ds18b20 in registry, all sensors convert at
+ *                  the same time so a full bus sample costs about one conversion time
+ *	 input args:	
+ *					$readings : readings output array
+ *					$max      : readings array size
+ * return value:    <0: failure   >=0: readings count
+ */
+int ds18b20GetTemperatures(ds18b20_reading_t *readings, int max) {
+
+    int                 i;
+    int                 rv;
+    int                 count = 0;
+    int                 n = 0;
+
+    // check input args
+    if( !readings || max <= 0 ) {
+    	return -1;
+    }
+
+    // rebuild registry when bus changed or last read failed
+    ds18b20CheckHotplug();
+    if( w1_bus.rescan && ds18b20Scan() < 0 ) {
+        return -2;
+    }
+
+    if( !w1_bus.count ) {
+        return -3;
+    }
+
+    count = w1_bus.count;
+    if( count > max ) {
+        logWarn("%d sensors on w1 bus, only %d will be read\n", count, max);
+        count = max;
+    }
+
+    // w1 master converts all slaves at once, then each read returns immediately
+    if( w1_bus.bulk_fd >= 0 && !ds18b20BulkConvert() ) {
+        for( i = 0; i < count; i++ ) {
+            if( (rv = ds18b20ReadFd(w1_bus.sensor[i].fd, &readings[n].mtemper)) < 0 ) {
+                logError("read data from sensor %s failure, errcode = %d\n", w1_bus.sensor[i].serial, rv);
+                if( rv == -1 ) {
+                    w1_bus.rescan = 1;
+                }
+                continue;
+            }
+            strncpy(readings[n].serial, w1_bus.sensor[i].serial, sizeof(readings[n].serial));
+            n++;
+        }
+    }
+    // otherwise every sensor converts in it's own worker thread
+    else {
+        n = ds18b20PoolRead(readings, count);
+    }
+
+    return n > 0 ? n : -4;
+}
+
+
+/*	description:	get the longest time ds18b20GetTemperatures() may block on sensors in
+ *                  registry, a failed bulk conversion falls back to worker rounds
+ *	 input args:	
+ *					$max      : readings array size
+ * return value:    milliseconds
+ */
+int ds18b20CollectMs(int max) {
+
+    int                 count = w1_bus.count < max ? w1_bus.count : max;
+    int                 workers = count < DS18B20_WORKERS ? count : DS18B20_WORKERS;
+    int                 ms = 0;
+
+    if( w1_bus.bulk_fd >= 0 ) {
+        ms += w1_bus.conv_ms + DS18B20_DEADLINE_MARGIN;
+    }
+    if( workers > 0 ) {
+        ms += (count + workers - 1) / workers * w1_bus.conv_ms + DS18B20_DEADLINE_MARGIN;
+    }
+
+    return ms;
 }
@@ -12,6 +12,8 @@
  ********************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <string.h>
 #include <netdb.h>
@@ -32,117 +34,577 @@
 #include <mosquitto.h>
 #include "mqtt.h"
 #include "readconf.h"
+#include "database.h"
 #include "logger.h"
+#include "clock.h"
 
 
-/*	description:	init mosquitto mqtt
+// reconnect backoff: doubled on every failure from MIN to MAX, then randomized in [delay/2, delay]
+#define MQTT_BACKOFF_MIN_MS         1000
+#define MQTT_BACKOFF_MAX_MS         64000
+// connection not acknowledged by broker in this time is treated as failure
+#define MQTT_CONNECT_TIMEOUT_MS     10000
+// broker address cached at first connection is resolved again after this many failures in row
+#define MQTT_RESOLVE_FAILURES       3
+// publish window, messages sent but not acknowledged by broker
+#define MQTT_INFLIGHT_DEFAULT       20
+#define MQTT_INFLIGHT_MAX           256
+// messages from database take at most this percent of publish window by default, rest is for live messages
+#define MQTT_STORED_PERCENT         75
+
+
+typedef struct mqtt_inflight_s {
+    int                 mid;                // mosquitto message id
+    int64_t             *ids;               // database records packeted in message, NULL means live message
+    int                 count;              // database records count
+    char                *data;              // samples record of live message, saved in database when connection lost
+    int                 bytes;              // samples record bytes
+}mqtt_inflight_t;
+
+
+/* Use static global handler in order to simplify API,
+ * but it will make this library not thread safe
+ */
+static struct {
+    struct mosquitto    *mosq;              // mosquitto mqtt client instance, lives until mqttTerm()
+    conf_t              *conf;              // client configurations
+    int                 connected;          // broker acknowledged connection
+    int                 connecting;         // socket opened, waiting for broker CONNACK
+    int                 resolve;            // broker address must be resolved before next connection
+    int                 failures;           // connection failures in row
+    unsigned int        seed;               // backoff jitter random seed
+    int64_t             attempt_ms;         // time of last connection attempt
+    int64_t             retry_ms;           // next connection attempt is not earlier than this time
+    char                addr[INET6_ADDRSTRLEN]; // cached broker numeric address
+    int                 window;             // publish window size
+    int                 inflight;           // messages in flight
+    int                 stored_window;      // most messages from database in flight
+    int                 stored;             // messages from database in flight
+    mqtt_inflight_t     slot[MQTT_INFLIGHT_MAX]; // messages in flight, slot is free when mid = 0
+    int                 acked;              // acknowledged database packets waiting to be removed
+    int64_t             ack[DATABASE_BATCH_MAX]; // record ids of acknowledged database packets
+} mqtt;
+
+
+/*	description:	resolve broker host to numeric address, so reconnection never waits on DNS.
+ *                  host is used as it is when resolving failure, mosquitto resolves it itself
+ */
+static void mqttResolve(void) {
+
+    struct addrinfo     hints = {0};
+    struct addrinfo     *res = NULL;
+    void                *addr = NULL;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if( getaddrinfo(mqtt.conf->host, NULL, &hints, &res) != 0 || !res ) {
+        logWarn("resolve broker host %s failure, connect with host name\n", mqtt.conf->host);
+        strncpy(mqtt.addr, mqtt.conf->host, sizeof(mqtt.addr) - 1);
+        mqtt.addr[sizeof(mqtt.addr) - 1] = '\0';
+        return;
+    }
+
+    if( res->ai_family == AF_INET6 ) {
+        addr = &((struct sockaddr_in6 *)res->ai_addr)->sin6_addr;
+    }
+    else {
+        addr = &((struct sockaddr_in *)res->ai_addr)->sin_addr;
+    }
+    inet_ntop(res->ai_family, addr, mqtt.addr, sizeof(mqtt.addr));
+    freeaddrinfo(res);
+    logInfo("resolve broker host %s to %s\n", mqtt.conf->host, mqtt.addr);
+
+    return;
+}
+
+
+/*	description:	remove acknowledged database records in one transaction */
+static void mqttAckFlush(void) {
+
+    if( mqtt.acked > 0 ) {
+        databaseDelPackets(mqtt.ack, mqtt.acked);
+        mqtt.acked = 0;
+    }
+
+    return;
+}
+
+
+/*	description:	connection lost, broker never acknowledges messages in flight now. live packets
+ *                  are saved in database, database packets just stay there to be sent again.
+ */
+static void mqttInflightRelease(void) {
+
+    int                 i;
+
+    // acknowledged ones are gone before database is read again from first packet
+    mqttAckFlush();
+
+    for( i = 0; i < MQTT_INFLIGHT_MAX && mqtt.inflight > 0; i++ ) {
+        if( !mqtt.slot[i].mid ) {
+            continue;
+        }
+        if( mqtt.slot[i].data ) {
+            databasePushPacket(mqtt.slot[i].data, mqtt.slot[i].bytes);
+        }
+        free(mqtt.slot[i].data);
+        free(mqtt.slot[i].ids);
+        memset(&mqtt.slot[i], 0, sizeof(mqtt.slot[i]));
+        mqtt.inflight--;
+    }
+    mqtt.stored = 0;
+
+    return;
+}
+
+
+/*	description:	connection attempt failure or connection lost, schedule next attempt with
+ *                  jittered exponential backoff, so clients don't reconnect all at once
+ */
+static void mqttBackoff(void) {
+
+    long long           delay = MQTT_BACKOFF_MIN_MS;
+    int                 i;
+
+    // connection was established, retry soon
+    if( mqtt.connected ) {
+        mqtt.failures = 0;
+    }
+    mqttInflightRelease();
+    mqtt.connected = 0;
+    mqtt.connecting = 0;
+    mqtt.failures++;
+
+    for( i = 1; i < mqtt.failures && delay < MQTT_BACKOFF_MAX_MS; i++ ) {
+        delay *= 2;
+    }
+    if( delay > MQTT_BACKOFF_MAX_MS ) {
+        delay = MQTT_BACKOFF_MAX_MS;
+    }
+    delay = delay / 2 + rand_r(&mqtt.seed) % (delay / 2 + 1);
+    mqtt.retry_ms = clockMonoMs() + delay;
+
+    if( mqtt.failures % MQTT_RESOLVE_FAILURES == 0 ) {
+        mqtt.resolve = 1;
+    }
+    logWarn("mosquitto mqtt connection failure %d times in row, retry in %lld ms\n", mqtt.failures, delay);
+
+    return;
+}
+
+
+/*	description:	mosquitto connect callback, called in mqttLoop() when broker answers CONNACK */
+static void mqttOnConnect(struct mosquitto *mosq, void *obj, int rc) {
+
+    (void)mosq;
+    (void)obj;
+
+    if( rc != 0 ) {
+        logError("broker refused connection: %s\n", mosquitto_connack_string(rc));
+        mqttBackoff();
+        return;
+    }
+
+    mqtt.connected = 1;
+    mqtt.connecting = 0;
+    mqtt.failures = 0;
+    logInfo("connect to broker success\n");
+
+    return;
+}
+
+
+/*	description:	mosquitto disconnect callback, called in mqttLoop() when connection is closed */
+static void mqttOnDisconnect(struct mosquitto *mosq, void *obj, int rc) {
+
+    (void)mosq;
+    (void)obj;
+
+    if( mqtt.connected || mqtt.connecting ) {
+        logWarn("disconnect from broker: %s\n", mosquitto_strerror(rc));
+        mqttBackoff();
+    }
+
+    return;
+}
+
+
+/*	description:	mosquitto publish callback, called in mqttLoop() when broker acknowledges a
+ *                  QoS 1/2 message or a QoS 0 message is sent. only here database packet is marked
+ *                  to be removed.
+ */
+static void mqttOnPublish(struct mosquitto *mosq, void *obj, int mid) {
+
+    int                 i;
+    int                 k;
+
+    (void)mosq;
+    (void)obj;
+
+    for( i = 0; i < MQTT_INFLIGHT_MAX; i++ ) {
+        if( mqtt.slot[i].mid == mid ) {
+            break;
+        }
+    }
+    // message was in flight before connection lost, it's already been saved again
+    if( i == MQTT_INFLIGHT_MAX ) {
+        return;
+    }
+
+    // removed in batch after mqttLoop(), or now when batch is full
+    for( k = 0; k < mqtt.slot[i].count; k++ ) {
+        mqtt.ack[mqtt.acked++] = mqtt.slot[i].ids[k];
+        if( mqtt.acked == DATABASE_BATCH_MAX ) {
+            mqttAckFlush();
+        }
+    }
+    if( mqtt.slot[i].ids ) {
+        mqtt.stored--;
+    }
+    free(mqtt.slot[i].data);
+    free(mqtt.slot[i].ids);
+    memset(&mqtt.slot[i], 0, sizeof(mqtt.slot[i]));
+    mqtt.inflight--;
+    logDebug("broker acknowledged message[%d], %d in flight\n", mid, mqtt.inflight);
+
+    return;
+}
+
+
+/*	description:	init mosquitto mqtt and create the client instance used during whole program
  *	 input args:	
- *					$mosq  : mosquitto mqtt pointer
+ *					$conf  : client configurations
  * return value:    <0: failure   0: success
  */
-int mqttInit(struct mosquitto *mosq) {
+int mqttInit(conf_t *conf) {
 	
+	// check input args
+	if( !conf ) {
+		return -1;
+	}
+
 	// init mosquitto lib
     if( mosquitto_lib_init() != MOSQ_ERR_SUCCESS ) {
-        return -1;
+        return -2;
+    }
+
+    memset(&mqtt, 0, sizeof(mqtt));
+    mqtt.conf = conf;
+    mqtt.resolve = 1;
+    mqtt.seed = (unsigned int)time(NULL) ^ (unsigned int)getpid();
+    mqtt.window = conf->inflight > 0 ? conf->inflight : MQTT_INFLIGHT_DEFAULT;
+    if( mqtt.window > MQTT_INFLIGHT_MAX ) {
+        mqtt.window = MQTT_INFLIGHT_MAX;
+    }
+    mqtt.stored_window = conf->backfillwindow > 0 ? conf->backfillwindow : mqtt.window * MQTT_STORED_PERCENT / 100;
+    if( mqtt.stored_window > mqtt.window ) {
+        mqtt.stored_window = mqtt.window;
+    }
+    if( mqtt.stored_window < 1 ) {
+        mqtt.stored_window = 1;
+    }
+
+    // create mosquitoo mqtt instance
+    mqtt.mosq = mosquitto_new(conf->clientid, true, NULL);
+    if( !mqtt.mosq ) {
+        logError("mosquitto_new() create failure\n");
+        return -3;
     }
 
-    // set mosq = NULL
-    mosq = NULL;
+    // set username and password
+    mosquitto_username_pw_set(mqtt.mosq, conf->username, conf->password);
+
+    // same backoff limits for libmosquitto's own reconnection, client schedules it's attempts in mqttConnect()
+    mosquitto_reconnect_delay_set(mqtt.mosq, MQTT_BACKOFF_MIN_MS / 1000, MQTT_BACKOFF_MAX_MS / 1000, true);
+    mosquitto_connect_callback_set(mqtt.mosq, mqttOnConnect);
+    mosquitto_disconnect_callback_set(mqtt.mosq, mqttOnDisconnect);
+    mosquitto_publish_callback_set(mqtt.mosq, mqttOnPublish);
+    mosquitto_max_inflight_messages_set(mqtt.mosq, mqtt.window);
 
     return 0;
 }
 
 
-/*	description:	terminate mosquitto mqtt
- *	 input args:	
- *					$mosq  : mosquitto mqtt pointer
- * return value:    <0: failure   0: success
+/*	description:	disconnect from broker and destroy mosquitto mqtt client instance, live
+ *                  packets not acknowledged yet are saved in database
  */
-int mqttTerm(struct mosquitto *mosq) {
+void mqttTerm(void) {
+
+    mqttInflightRelease();
 
     // clean mosquitto instance and set mosq = NULL
-    if( mosq ) {
-        mosquitto_destroy(mosq);
-        mosq = NULL;
+    if( mqtt.mosq ) {
+        if( mqtt.connected ) {
+            mqtt.connected = 0;
+            mosquitto_disconnect(mqtt.mosq);
+            mosquitto_loop_write(mqtt.mosq, 1);
+        }
+        mosquitto_destroy(mqtt.mosq);
+        mqtt.mosq = NULL;
     }
     
-    return 0;
+    return;
 }
 
 
-/*	description:	mosquitto mqtt client connect to broker
- *	 input args:	
- *					$mosq  : mosquitto mqtt pointer
- *					$conf  : client configurations
- * return value:    <0: failure   0: success
+/*	description:	start asynchronous connection to broker when it's not connected and backoff time
+ *                  is up. socket is connecting in background, mqttLoop() completes connection.
+ * return value:    <0: failure   0: new socket is opened   1: nothing to do now
  */
-int mqttConnect(struct mosquitto *mosq, conf_t *conf) {
+int mqttConnect(void) {
 
     int                 rv = 0;
-    char                service[24] = {0};
-    struct addrinfo     hints = {0}, *res = NULL, *rp = NULL;
-    struct in_addr      inaddr = {0};
-    struct mosquitto	*tmp_mosq = NULL;
+    conf_t              *conf = mqtt.conf;
+    int64_t             now = clockMonoMs();
     
-    // check input args
-    if( !mosq || !conf ) {
+    // check mqtt init
+    if( !conf || !mqtt.mosq ) {
         return -1;
     }
 
-    // make sure this mosquitto instance not already exist
-    mqttTerm(mosq);
+    // broker not answer in time, old socket will be closed by next attempt
+    if( mqtt.connecting && now - mqtt.attempt_ms >= MQTT_CONNECT_TIMEOUT_MS ) {
+        logError("connect to broker timeout\n");
+        mqttBackoff();
+    }
 
-    // create a new mosquitoo mqtt instance
-    tmp_mosq = mosquitto_new(conf->clientid, true, NULL);
-    if( !tmp_mosq ) {
-        logError("mosquitto_new() create failure\n");
-        mosquitto_destroy(tmp_mosq);
-        return -2;
+    if( mqtt.connected || mqtt.connecting || now < mqtt.retry_ms ) {
+        return 1;
+    }
+
+    mqtt.attempt_ms = now;
+    if( mqtt.resolve ) {
+        // connect with new address, only DNS lookup happens here
+        mqttResolve();
+        mqtt.resolve = 0;
+        rv = mosquitto_connect_async(mqtt.mosq, mqtt.addr, conf->port, conf->keepalive);
+    }
+    else {
+        // reconnect with cached address, keepalive and session settings
+        rv = mosquitto_reconnect_async(mqtt.mosq);
     }
-        
-    // set username and password
-    mosquitto_username_pw_set(tmp_mosq, conf->username, conf->password);
 
-    // connect to broker
-    rv = mosquitto_connect(tmp_mosq, conf->host, conf->port, conf->keepalive);
     if( rv != MOSQ_ERR_SUCCESS ) {
      	// connect get error
-     	logError("mosquitto_connect() connect to broker faliure\n");
-        mqttTerm(tmp_mosq);
-        return -3;
+     	logError("connect to broker %s:%d faliure: %s\n", mqtt.addr, conf->port, mosquitto_strerror(rv));
+        mqttBackoff();
+        return -2;
     }
-    mosq = tmp_mosq;
-    logInfo("connect to broker success\n");
+    mqtt.connecting = 1;
+    logDebug("connecting to broker %s:%d\n", mqtt.addr, conf->port);
     
     return 0;
 }
 
 
-/*	description:	mosquitto mqtt client publish data to broker
+/*	description:	check mosquitto mqtt client connected to broker
+ * return value:    1: connected   0: not connected
+ */
+int mqttConnected(void) {
+
+    return mqtt.connected;
+}
+
+
+/*	description:	get mosquitto mqtt client socket, caller waits on it in event loop
+ * return value:    <0: no socket   >=0: socket
+ */
+int mqttSocket(void) {
+
+    return mqtt.mosq ? mosquitto_socket(mqtt.mosq) : -1;
+}
+
+
+/*	description:	check mosquitto mqtt client has data waiting to be written
+ * return value:    1: wait socket writable   0: no data to write
+ */
+int mqttWantWrite(void) {
+
+    return mqtt.mosq ? mosquitto_want_write(mqtt.mosq) : 0;
+}
+
+
+/*	description:	handle socket events and periodic work(keepalive, retry) of mosquitto mqtt client
  *	 input args:	
- *					$mosq  : mosquitto mqtt pointer
- *					$data  : packeted data(JSON)
+ *					$readable : socket readable
+ *					$writable : socket writable
+ * return value:    <0: connection lost   0: success
+ */
+int mqttLoop(int readable, int writable) {
+
+    int         rv = MOSQ_ERR_SUCCESS;
+
+    if( !mqtt.mosq || mqttSocket() < 0 ) {
+        return -1;
+    }
+
+    if( readable ) {
+        rv = mosquitto_loop_read(mqtt.mosq, 1);
+    }
+    if( rv == MOSQ_ERR_SUCCESS && writable ) {
+        rv = mosquitto_loop_write(mqtt.mosq, 1);
+    }
+    if( rv == MOSQ_ERR_SUCCESS ) {
+        rv = mosquitto_loop_misc(mqtt.mosq);
+    }
+    mqttAckFlush();
+
+    if( rv != MOSQ_ERR_SUCCESS ) {
+        // disconnect callback already scheduled next attempt if connection was up
+        if( mqtt.connected || mqtt.connecting ) {
+            logError("mosquitto mqtt connection lost: %s\n", mosquitto_strerror(rv));
+            mqttBackoff();
+        }
+        return -2;
+    }
+
+    return 0;
+}
+
+
+/*	description:	get free slots in publish window
+ * return value:    free slots, 0 when not connected
+ */
+int mqttInflightFree(void) {
+
+    return mqtt.connected ? mqtt.window - mqtt.inflight : 0;
+}
+
+
+/*	description:	get free slots in publish window for messages from database, part of window
+ *                  is always left for live messages
+ * return value:    free slots, 0 when not connected
+ */
+int mqttStoredFree(void) {
+
+    int         free_slots = mqttInflightFree();
+
+    if( free_slots > mqtt.stored_window - mqtt.stored ) {
+        free_slots = mqtt.stored_window - mqtt.stored;
+    }
+
+    return free_slots > 0 ? free_slots : 0;
+}
+
+
+/*	description:	get messages from database in publish window
+ * return value:    messages waiting for acknowledge
+ */
+int mqttStoredInflight(void) {
+
+    return mqtt.stored;
+}
+
+
+/*	description:	mosquitto mqtt client publish data to broker, message stays in publish window
+ *                  until broker acknowledges it
+ *	 input args:	
+ *					$data  : packeted data
  *					$bytes : data total bytes
+ *					$ids   : database record ids removed when acknowledged, NULL means live message
+ *					$count : database record ids count
+ *					$save  : samples record of live message saved in database when connection lost
+ *					$size  : samples record bytes
  * return value:    <0: failure   0: success
  */
-int mqttPublish(struct mosquitto *mosq, char *data, int bytes) {
+static int mqttPublishSlot(char *data, int bytes, int64_t *ids, int count, char *save, int size) {
 	
 	int			rv = 0;
+	int			i;
+	char		*copy = NULL;
+	int64_t		*idcopy = NULL;
+	char		*topic = mqtt.conf->pubtopic;
 	
 	// check input args
-	if( !mosq || !data || bytes <= 0 ) {
+	if( !mqtt.connected || !data || bytes <= 0 ) {
 		return -1;
 	}
 	
-	// publish data to broker
-	rv = mosquitto_publish(mosq, NULL, conf->pubtopic, bytes + 1, data, conf->qos, false);
-	if( rv != MOSQ_ERR_SUCCESS ) {
-		logError("publish data to broker faliure\n");
-		mqttTerm(mosq);
+	// publish window is full
+	if( mqtt.inflight >= mqtt.window ) {
 		return -2;
 	}
-	logInfo("publish data to broker success\n");
+	for( i = 0; i < MQTT_INFLIGHT_MAX && mqtt.slot[i].mid; i++ ) {
+	}
+	
+	// live message is not in database, keep a copy of it's samples until it's acknowledged
+	if( (save && size > 0 && !(copy = malloc(size))) || (ids && count > 0 && !(idcopy = malloc(count * sizeof(ids[0])))) ) {
+		free(copy);
+		return -3;
+	}
+	if( copy ) {
+		memcpy(copy, save, size);
+	}
+	if( idcopy ) {
+		memcpy(idcopy, ids, count * sizeof(ids[0]));
+		mqtt.stored++;
+		// historical samples go to their own topic, so dashboards of live topic never show stale data
+		if( mqtt.conf->histopic[0] ) {
+			topic = mqtt.conf->histopic;
+		}
+	}
+	
+	// slot is filled before publish, QoS 0 message may be acknowledged inside mosquitto_publish()
+	mqtt.slot[i].ids = idcopy;
+	mqtt.slot[i].count = idcopy ? count : 0;
+	mqtt.slot[i].data = copy;
+	mqtt.slot[i].bytes = copy ? size : 0;
+	mqtt.inflight++;
+	
+	// publish data to broker, connection error is handled in mqttLoop()
+	rv = mosquitto_publish(mqtt.mosq, &mqtt.slot[i].mid, topic, bytes, data, mqtt.conf->qos, false);
+	if( rv != MOSQ_ERR_SUCCESS ) {
+		logError("publish data to broker faliure: %s\n", mosquitto_strerror(rv));
+		// connection lost inside mosquitto_publish() already saved this message
+		if( mqtt.slot[i].ids != idcopy || mqtt.slot[i].data != copy ) {
+			return 0;
+		}
+		if( idcopy ) {
+			mqtt.stored--;
+		}
+		free(copy);
+		free(idcopy);
+		memset(&mqtt.slot[i], 0, sizeof(mqtt.slot[i]));
+		mqtt.inflight--;
+		return -4;
+	}
+	
+	logDebug("publish message[%d] to broker, %d in flight\n", mqtt.slot[i].mid, mqtt.inflight);
 	
 	return 0;
 }
+
+
+/*	description:	mosquitto mqtt client publish live message to broker, message stays in publish
+ *                  window until broker acknowledges it
+ *	 input args:	
+ *					$data   : packeted data
+ *					$bytes  : data total bytes
+ *					$record : samples record of message, saved in database when connection lost
+ *					$size   : samples record bytes
+ * return value:    <0: failure   0: success
+ */
+int mqttPublish(char *data, int bytes, char *record, int size) {
+
+	return mqttPublishSlot(data, bytes, NULL, 0, record, size);
+}
+
+
+/*	description:	mosquitto mqtt client publish message packeted from database records to broker,
+ *                  records are removed when broker acknowledges it
+ *	 input args:	
+ *					$data  : packeted data
+ *					$bytes : data total bytes
+ *					$ids   : database record ids
+ *					$count : database record ids count
+ * return value:    <0: failure   0: success
+ */
+int mqttPublishStored(char *data, int bytes, int64_t *ids, int count) {
+
+	// check input args
+	if( !ids || count <= 0 ) {
+		return -1;
+	}
+
+	return mqttPublishSlot(data, bytes, ids, count, NULL, 0);
+}
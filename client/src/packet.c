@@ -18,33 +18,178 @@
 #include "packet.h"
 #include "logger.h"
 #include "ds18b20.h"
+#include "cbor.h"
+#include "tscodec.h"
+#include "clock.h"
 
 
-/*	description:	get sample time
+// packet fragment in template, length is known at compile time
+#define PACK_FRAGMENT(str)      str, sizeof(str) - 1
+
+// append a string literal
+#define packetPutConst(w, str)  packetPut(w, str, sizeof(str) - 1)
+
+// ds18b20 serial "28-0316a279a2ff" is 1 byte family code and 6 bytes id in CBOR
+#define PACK_ROM_LEN            7
+
+// packet writer, appends fragments with length tracking, len >= size means buffer is too small
+typedef struct pack_writer_s {
+    char                *buf;               // output buffer
+    int                 size;               // output buffer size
+    int                 len;                // bytes packeted, keeps counting when buffer is full
+} pack_writer_t;
+
+// single sample json message around sensors fields
+typedef struct pack_template_s {
+    const char          *prefix;
+    int                 prefix_len;
+    const char          *suffix;
+    int                 suffix_len;
+} pack_template_t;
+
+static int packetJsonBatchHuawei(pack_writer_t *w, pack_info_t *pack_info, int count);
+static int packetJsonBatchAliyun(pack_writer_t *w, pack_info_t *pack_info, int count);
+static int packetJsonBatchTencent(pack_writer_t *w, pack_info_t *pack_info, int count);
+
+// templates of Huawei Cloud, Aliyun, Tencent Cloud
+static const pack_template_t  pack_templates[] = {
+    { PACK_FRAGMENT("{\"services\": [{\"service_id\": \"1\",\"properties\": {"), PACK_FRAGMENT("}}]}") },
+    { PACK_FRAGMENT("{\"params\": {"), PACK_FRAGMENT("}}") },
+    { PACK_FRAGMENT("{\"type\": \"update\",\"state\": {\"reported\": {"), PACK_FRAGMENT("}},\"version\": 1,   \"clientToken\": \"clientToken\"}") },
+};
+
+static int (* const pack_batch_funcs[])(pack_writer_t *, pack_info_t *, int) = {
+    packetJsonBatchHuawei,
+    packetJsonBatchAliyun,
+    packetJsonBatchTencent,
+};
+
+/* Platform is chosen once by packetInit(), default Huawei Cloud */
+static const pack_template_t    *pack_template = &pack_templates[0];
+static int                      (*pack_batch)(pack_writer_t *, pack_info_t *, int) = packetJsonBatchHuawei;
+
+
+/*	description:	append bytes to packet, only bytes counted when buffer is full
+ *	 input args:	
+ *					$w    : packet writer
+ *					$data : bytes to append
+ *					$len  : bytes count
+ */
+static inline void packetPut(pack_writer_t *w, const char *data, int len) {
+
+    if( w->len + len < w->size ) {
+        memcpy(w->buf + w->len, data, len);
+    }
+    w->len += len;
+
+    return;
+}
+
+
+/*	description:	append NUL terminated string to packet
+ *	 input args:	
+ *					$w   : packet writer
+ *					$str : string
+ */
+static inline void packetPutStr(pack_writer_t *w, const char *str) {
+
+    packetPut(w, str, strlen(str));
+
+    return;
+}
+
+
+/*	description:	append decimal integer to packet
+ *	 input args:	
+ *					$w     : packet writer
+ *					$value : integer
+ */
+static void packetPutInt(pack_writer_t *w, long long value) {
+
+    char                digits[24];
+    int                 i = sizeof(digits);
+    unsigned long long  v = value < 0 ? -(unsigned long long)value : (unsigned long long)value;
+
+    do {
+        digits[--i] = '0' + v % 10;
+        v /= 10;
+    } while( v );
+    if( value < 0 ) {
+        digits[--i] = '-';
+    }
+    packetPut(w, digits + i, sizeof(digits) - i);
+
+    return;
+}
+
+
+/*	description:	append milli-degrees temperature as degrees with 2 decimals, fixed point
+ *	 input args:	
+ *					$w       : packet writer
+ *					$mtemper : temperature in milli-degrees Celsius
+ */
+static void packetPutTemper(pack_writer_t *w, int mtemper) {
+
+    char                digits[16];
+    int                 i = sizeof(digits);
+    // round half away from zero to centi-degrees
+    unsigned int        centi = mtemper < 0 ? (-(unsigned int)mtemper + 5) / 10 : ((unsigned int)mtemper + 5) / 10;
+    int                 negative = (mtemper < 0 && centi);
+
+    digits[--i] = '0' + centi % 10;
+    digits[--i] = '0' + centi / 10 % 10;
+    digits[--i] = '.';
+    centi /= 100;
+    do {
+        digits[--i] = '0' + centi % 10;
+        centi /= 10;
+    } while( centi );
+    if( negative ) {
+        digits[--i] = '-';
+    }
+    packetPut(w, digits + i, sizeof(digits) - i);
+
+    return;
+}
+
+
+/*	description:	finish packet, NUL terminate it
+ *	 input args:	
+ *					$w : packet writer
+ * return value:    <0: buffer is too small   >0: packet bytes
+ */
+static int packetEnd(pack_writer_t *w) {
+
+    if( w->len >= w->size ) {
+        return -2;
+    }
+    w->buf[w->len] = '\0';
+
+    return w->len;
+}
+
+
+/*	description:	choose packet templates of broker platform, called once at config time
  *	 input args:	
- *					$sample_time : time information buffer
- *					$size        : buffer size
+ *					$platform : broker platform, 1 means HW, 2 means AL, 3 means TX
  * return value:    <0: failure   0: success
  */
-int getTime(char *sample_time, int size) {
-       
-    time_t 			t = time(NULL);
-    struct tm 		*tm = localtime(&t);
-    
+int packetInit(int platform) {
+
     // check input args
-    if( !sample_time || size < 0) {
-    	logError("function %s() gets invalid input arugments\n", __func__);
-    	return -1;
-    }
-    
-    memset(sample_time, 0, size);
-    strftime(sample_time, size, "%Y-%m-%d %H:%M:%S", tm);
-    
+    if( platform < 1 || platform > (int)(sizeof(pack_templates) / sizeof(pack_templates[0])) ) {
+        logError("function %s() gets invalid platform %d\n", __func__, platform);
+        return -1;
+    }
+
+    pack_template = &pack_templates[platform - 1];
+    pack_batch = pack_batch_funcs[platform - 1];
+
     return 0;
 }
 
 
-/*	description:	packet segment data into text, include device ID, sample time, sample temper
+/*	description:	packet segment data into text, include device ID, sample time, every sensor temper
  *	 input args:	
  *					$pack_info : struct whitch store segment data
  *                  $pack_buf  : buffer whitch will store packeted data
@@ -53,46 +198,694 @@ int getTime(char *sample_time, int size) {
  */
 int packetSegmentData(pack_info_t *pack_info, char *pack_buf, int size) {
 
+    int             i;
+    pack_writer_t   w = { pack_buf, size, 0 };
+
     // check input args
     if( !pack_info || !pack_buf || size <= 0 ) {
         logError("function %s() gets invalid input arguments\n", __func__);
         return -1;
     }
-    
-    memset(pack_buf, 0, size);
-    snprintf(pack_buf, size, "%s,%s,%.2f", pack_info->devid, pack_info->sample_time, pack_info->temper);
 
-    return strlen(pack_buf);
+    packetPutStr(&w, pack_info->devid);
+    packetPutConst(&w, ",");
+    packetPutStr(&w, pack_info->sample_time);
+
+    // append serial:temper of every sensor
+    for( i = 0; i < pack_info->count; i++ ) {
+        packetPutConst(&w, ",");
+        packetPutStr(&w, pack_info->reading[i].serial);
+        packetPutConst(&w, ":");
+        packetPutTemper(&w, pack_info->reading[i].mtemper);
+    }
+
+    if( packetEnd(&w) < 0 ) {
+        logError("packet buffer size[%d] is too small\n", size);
+        return -2;
+    }
+
+    return w.len;
 }
 
 
-/*	description:	packet segment data into json, include device ID, sample time, sample temper
+/*	description:	packet every sensor temper into json array
+ *	 input args:	
+ *					$w         : packet writer
+ *					$pack_info : struct whitch store segment data
+ */
+static void packetJsonSensors(pack_writer_t *w, pack_info_t *pack_info) {
+
+    int         i;
+
+    packetPutConst(w, "\"temperature\": ");
+    packetPutTemper(w, pack_info->count ? pack_info->reading[0].mtemper : 0);
+    packetPutConst(w, ",\"sensors\": [");
+    for( i = 0; i < pack_info->count; i++ ) {
+        if( i ) {
+            packetPutConst(w, ",");
+        }
+        packetPutConst(w, "{\"id\": \"");
+        packetPutStr(w, pack_info->reading[i].serial);
+        packetPutConst(w, "\",\"temperature\": ");
+        packetPutTemper(w, pack_info->reading[i].mtemper);
+        packetPutConst(w, "}");
+    }
+    packetPutConst(w, "]");
+
+    return;
+}
+
+
+/*	description:	packet segment data into json, include every sensor temper, first sensor
+ *                  temper is also reported as "temperature" for single probe boards
  *	 input args:	
  *					$pack_info : struct whitch store segment data
  *                  $pack_buf  : buffer whitch will store packeted data
  *                  $size      : buffer size 
  * return value:    <0: failure   >0: success
  */
-int packetJsonData(pack_info_t *pack_info, char *pack_buf, int size, int platform) {
+int packetJsonData(pack_info_t *pack_info, char *pack_buf, int size) {
+
+    pack_writer_t   w = { pack_buf, size, 0 };
 
     // check input args
     if( !pack_info || !pack_buf || size <= 0 ) {
-        logError("function %s() gets invalid input arguments\n");
+        logError("function %s() gets invalid input arguments\n", __func__);
         return -1;
     }
 
-    memset(pack_buf, 0, size);
-    
-    // packet data into JSON
-    if( platform == 1 ) {
-    	snprintf(pack_buf, size, "{\"services\": [{\"service_id\": \"1\",\"properties\": {\"temperature\": %.2f}}]}", pack_info->temper);
+    packetPut(&w, pack_template->prefix, pack_template->prefix_len);
+    packetJsonSensors(&w, pack_info);
+    packetPut(&w, pack_template->suffix, pack_template->suffix_len);
+
+    if( packetEnd(&w) < 0 ) {
+        logError("packet buffer size[%d] is too small\n", size);
+        return -2;
     }
-    else if( platform == 2 ) {
-    	snprintf(pack_buf, size, "{\"params\": {\"temperature\": %.2f}}", pack_info->temper);
+
+    return w.len;
+}
+
+
+/*	description:	packet samples in Huawei services[] form, sample time in event_time(UTC yyyyMMddTHHmmssZ)
+ *	 input args:	
+ *					$w         : packet writer
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count
+ * return value:    <0: buffer is too small   >0: packet bytes
+ */
+static int packetJsonBatchHuawei(pack_writer_t *w, pack_info_t *pack_info, int count) {
+
+    int             i;
+    int             bytes;
+    char            event_time[TIME_LEN];
+
+    packetPutConst(w, "{\"services\": [");
+    for( i = 0; i < count && w->len < w->size; i++ ) {
+        // consecutive samples in one second share formatted time
+        if( (bytes = clockIsoUtc(pack_info[i].sample_ms, event_time, sizeof(event_time))) < 0 ) {
+            return -1;
+        }
+        if( i ) {
+            packetPutConst(w, ",");
+        }
+        packetPutConst(w, "{\"service_id\": \"1\",\"properties\": {");
+        packetJsonSensors(w, &pack_info[i]);
+        packetPutConst(w, "},\"event_time\": \"");
+        packetPut(w, event_time, bytes);
+        packetPutConst(w, "\"}");
     }
-	else if( platform == 3 ) {
-		snprintf(pack_buf, size, "{\"type\": \"update\",\"state\": {\"reported\": {\"temperature\": %.2f}},\"version\": 1,   \"clientToken\": \"clientToken\"", pack_info->temper);
-	}
-	
-    return strlen(pack_buf);
+    packetPutConst(w, "]}");
+
+    return packetEnd(w);
+}
+
+
+/*	description:	packet samples in Aliyun params properties form, every property is an array of value and time
+ *	 input args:	
+ *					$w         : packet writer
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count
+ * return value:    <0: buffer is too small   >0: packet bytes
+ */
+static int packetJsonBatchAliyun(pack_writer_t *w, pack_info_t *pack_info, int count) {
+
+    int             i;
+    int             j;
+
+    packetPutConst(w, "{\"params\": {\"properties\": {\"temperature\": [");
+    for( i = 0; i < count && w->len < w->size; i++ ) {
+        if( i ) {
+            packetPutConst(w, ",");
+        }
+        packetPutConst(w, "{\"value\": ");
+        packetPutTemper(w, pack_info[i].count ? pack_info[i].reading[0].mtemper : 0);
+        packetPutConst(w, ",\"time\": ");
+        packetPutInt(w, pack_info[i].sample_ms);
+        packetPutConst(w, "}");
+    }
+    packetPutConst(w, "],\"sensors\": [");
+    for( i = 0; i < count && w->len < w->size; i++ ) {
+        if( i ) {
+            packetPutConst(w, ",");
+        }
+        packetPutConst(w, "{\"value\": [");
+        for( j = 0; j < pack_info[i].count; j++ ) {
+            if( j ) {
+                packetPutConst(w, ",");
+            }
+            packetPutConst(w, "{\"id\": \"");
+            packetPutStr(w, pack_info[i].reading[j].serial);
+            packetPutConst(w, "\",\"temperature\": ");
+            packetPutTemper(w, pack_info[i].reading[j].mtemper);
+            packetPutConst(w, "}");
+        }
+        packetPutConst(w, "],\"time\": ");
+        packetPutInt(w, pack_info[i].sample_ms);
+        packetPutConst(w, "}");
+    }
+    packetPutConst(w, "]}}}");
+
+    return packetEnd(w);
+}
+
+
+/*	description:	packet samples in Tencent state.reported form, shadow reports latest sample,
+ *                  samples[] keeps every sample with timestamp
+ *	 input args:	
+ *					$w         : packet writer
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count
+ * return value:    <0: buffer is too small   >0: packet bytes
+ */
+static int packetJsonBatchTencent(pack_writer_t *w, pack_info_t *pack_info, int count) {
+
+    int             i;
+
+    packetPutConst(w, "{\"type\": \"update\",\"state\": {\"reported\": {");
+    packetJsonSensors(w, &pack_info[count - 1]);
+    packetPutConst(w, ",\"samples\": [");
+    for( i = 0; i < count && w->len < w->size; i++ ) {
+        if( i ) {
+            packetPutConst(w, ",");
+        }
+        packetPutConst(w, "{\"timestamp\": ");
+        packetPutInt(w, pack_info[i].sample_ms);
+        packetPutConst(w, ",");
+        packetJsonSensors(w, &pack_info[i]);
+        packetPutConst(w, "}");
+    }
+    packetPutConst(w, "]}},\"version\": 1,   \"clientToken\": \"clientToken\"}");
+
+    return packetEnd(w);
+}
+
+
+/*	description:	packet samples into one json message in platform's multi-point form, Huawei
+ *                  services[] with event_time, Aliyun params properties with time, Tencent
+ *                  state.reported with samples[]. one sample is packeted by packetJsonData()
+ *	 input args:	
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+int packetJsonBatch(pack_info_t *pack_info, int count, char *pack_buf, int size) {
+
+    pack_writer_t   w = { pack_buf, size, 0 };
+
+    // check input args
+    if( !pack_info || count <= 0 || !pack_buf || size <= 0 ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    if( count == 1 ) {
+        return packetJsonData(pack_info, pack_buf, size);
+    }
+
+    // not logged, batch packets less samples when it's too large
+    return pack_batch(&w, pack_info, count);
+}
+
+
+/*	description:	convert w1 serial "ff-hhhhhhhhhhhh" into family code and 48 bits id
+ *	 input args:	
+ *					$serial : ds18b20 serial number
+ *					$rom    : output, family code and id in big endian
+ * return value:    <0: serial is not in this form   0: success
+ */
+static int packetSerialToRom(const char *serial, unsigned char *rom) {
+
+    int             i;
+    int             nibble;
+    const char      *c;
+
+    if( strlen(serial) != PACK_ROM_LEN * 2 + 1 || serial[2] != '-' ) {
+        return -1;
+    }
+
+    memset(rom, 0, PACK_ROM_LEN);
+    for( i = 0, c = serial; i < PACK_ROM_LEN * 2; i++, c++ ) {
+        if( c == serial + 2 ) {
+            c++;
+        }
+        if( *c >= '0' && *c <= '9' ) {
+            nibble = *c - '0';
+        }
+        else if( *c >= 'a' && *c <= 'f' ) {
+            nibble = *c - 'a' + 10;
+        }
+        else {
+            return -2;
+        }
+        rom[i / 2] |= nibble << (i % 2 ? 0 : 4);
+    }
+
+    return 0;
+}
+
+
+/*	description:	convert family code and 48 bits id back into w1 serial "ff-hhhhhhhhhhhh"
+ *	 input args:	
+ *					$rom    : family code and id in big endian
+ *					$serial : output, DS18B20_SN_LEN bytes
+ */
+static void packetRomToSerial(const unsigned char *rom, char *serial) {
+
+    snprintf(serial, DS18B20_SN_LEN, "%02x-%02x%02x%02x%02x%02x%02x", rom[0], rom[1], rom[2], rom[3], rom[4], rom[5], rom[6]);
+
+    return;
+}
+
+
+/*	description:	packet samples into CBOR: [version, devid, sample...], every sample is
+ *                  [epoch ms, serial, milli-degrees, serial, milli-degrees...], serial is
+ *                  7 bytes family code and id, or text if it's not in w1 form
+ *	 input args:	
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+int packetCborBatch(pack_info_t *pack_info, int count, char *pack_buf, int size) {
+
+    int             i;
+    int             j;
+    unsigned char   rom[PACK_ROM_LEN];
+    cbor_buf_t      cb;
+
+    // check input args
+    if( !pack_info || count <= 0 || !pack_buf || size <= 0 ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    cborInit(&cb, pack_buf, size);
+    cborPutArray(&cb, 2 + count);
+    cborPutUint(&cb, PACK_CBOR_VERSION);
+    cborPutText(&cb, pack_info[0].devid, strlen(pack_info[0].devid));
+
+    for( i = 0; i < count && cb.len <= size; i++ ) {
+        cborPutArray(&cb, 1 + 2 * pack_info[i].count);
+        cborPutInt(&cb, pack_info[i].sample_ms);
+        for( j = 0; j < pack_info[i].count; j++ ) {
+            if( !packetSerialToRom(pack_info[i].reading[j].serial, rom) ) {
+                cborPutBytes(&cb, rom, sizeof(rom));
+            }
+            else {
+                cborPutText(&cb, pack_info[i].reading[j].serial, strlen(pack_info[i].reading[j].serial));
+            }
+            cborPutInt(&cb, pack_info[i].reading[j].mtemper);
+        }
+    }
+
+    // not logged, batch packets less samples when it's too large
+    return cborEnd(&cb) < 0 ? -2 : cb.len;
+}
+
+
+/*	description:	packet segment data into CBOR, same as one sample batch
+ *	 input args:	
+ *					$pack_info : struct whitch store segment data
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+int packetCborData(pack_info_t *pack_info, char *pack_buf, int size) {
+
+    int             bytes = packetCborBatch(pack_info, 1, pack_buf, size);
+
+    if( bytes == -2 ) {
+        logError("packet buffer size[%d] is too small\n", size);
+    }
+
+    return bytes;
+}
+
+
+/*	description:	decode CBOR packet from packetCborBatch(), for the consumer side
+ *	 input args:	
+ *                  $pack_buf  : CBOR packet
+ *                  $bytes     : CBOR packet bytes
+ *					$pack_info : samples output, sample_time is not filled
+ *					$max       : samples output buffer count
+ * return value:    <0: failure   >=0: samples decoded
+ */
+int packetCborDecode(const char *pack_buf, int bytes, pack_info_t *pack_info, int max) {
+
+    int                     i;
+    int                     j;
+    int                     count;
+    int                     items;
+    int                     major;
+    int                     len;
+    int64_t                 value;
+    const unsigned char     *data;
+    char                    devid[DEVID_LEN] = {0};
+    cbor_buf_t              cb;
+
+    // check input args
+    if( !pack_buf || bytes <= 0 || !pack_info || max <= 0 ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    cborInit(&cb, (void *)pack_buf, bytes);
+    if( cborGetArray(&cb, &count) < 0 || count < 2 ) {
+        return -2;
+    }
+    if( cborGetInt(&cb, &value) < 0 || value != PACK_CBOR_VERSION ) {
+        return -3;
+    }
+    if( cborGetString(&cb, &major, &data, &len) < 0 || major != CBOR_TEXT ) {
+        return -4;
+    }
+    memcpy(devid, data, len < DEVID_LEN - 1 ? len : DEVID_LEN - 1);
+
+    for( i = 0; i < count - 2 && i < max; i++ ) {
+        memset(&pack_info[i], 0, sizeof(pack_info[i]));
+        strcpy(pack_info[i].devid, devid);
+
+        if( cborGetArray(&cb, &items) < 0 || items < 1 || items % 2 == 0 ) {
+            return -5;
+        }
+        if( cborGetInt(&cb, &pack_info[i].sample_ms) < 0 ) {
+            return -6;
+        }
+
+        for( j = 0; j < items / 2; j++ ) {
+            if( cborGetString(&cb, &major, &data, &len) < 0 || cborGetInt(&cb, &value) < 0 ) {
+                return -7;
+            }
+            // readings beyond PACK_MAX_SENSORS are skipped
+            if( j >= PACK_MAX_SENSORS ) {
+                continue;
+            }
+            if( major == CBOR_BYTES && len == PACK_ROM_LEN ) {
+                packetRomToSerial(data, pack_info[i].reading[j].serial);
+            }
+            else {
+                memcpy(pack_info[i].reading[j].serial, data, len < DS18B20_SN_LEN - 1 ? len : DS18B20_SN_LEN - 1);
+            }
+            pack_info[i].reading[j].mtemper = (int)value;
+            pack_info[i].count++;
+        }
+    }
+
+    return i;
+}
+
+
+/*	description:	packet samples into time series columns: "TS", version, devid, sensors
+ *                  table sorted by serial, samples count, delta of delta timestamps column,
+ *                  then one zigzag delta values column with presence bitmap per sensor
+ *	 input args:	
+ *					$pack_info : samples, oldest first
+ *					$count     : samples count, most PACK_TS_MAX_SAMPLES
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+int packetTsBatch(pack_info_t *pack_info, int count, char *pack_buf, int size) {
+
+    int             i;
+    int             j;
+    int             k;
+    int             nsensors = 0;
+    int             cmp = 0;
+    const char      *sensor[PACK_MAX_SENSORS];
+    int64_t         ts[PACK_TS_MAX_SAMPLES];
+    int             values[PACK_TS_MAX_SAMPLES];
+    unsigned char   present[PACK_TS_MAX_SAMPLES];
+    unsigned char   rom[PACK_ROM_LEN];
+    tscodec_buf_t   tb;
+
+    // check input args
+    if( !pack_info || count <= 0 || count > PACK_TS_MAX_SAMPLES || !pack_buf || size <= 0 ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    // sensors table is every serial in samples, sorted as ds18b20 registry does
+    for( i = 0; i < count; i++ ) {
+        ts[i] = pack_info[i].sample_ms;
+        for( j = 0; j < pack_info[i].count; j++ ) {
+            for( k = 0; k < nsensors && (cmp = strcmp(sensor[k], pack_info[i].reading[j].serial)) < 0; k++ ) {
+            }
+            if( (k < nsensors && !cmp) || nsensors == PACK_MAX_SENSORS ) {
+                continue;
+            }
+            memmove(&sensor[k + 1], &sensor[k], (nsensors - k) * sizeof(sensor[0]));
+            sensor[k] = pack_info[i].reading[j].serial;
+            nsensors++;
+        }
+    }
+
+    tscodecInit(&tb, pack_buf, size);
+    tscodecPutRaw(&tb, PACK_TS_MAGIC, 2);
+    tscodecPutVarint(&tb, PACK_TS_VERSION);
+    tscodecPutVarint(&tb, strlen(pack_info[0].devid));
+    tscodecPutRaw(&tb, pack_info[0].devid, strlen(pack_info[0].devid));
+
+    // serial is 7 bytes family code and id, or text if it's not in w1 form
+    tscodecPutVarint(&tb, nsensors);
+    for( k = 0; k < nsensors; k++ ) {
+        if( !packetSerialToRom(sensor[k], rom) ) {
+            tscodecPutVarint(&tb, 0);
+            tscodecPutRaw(&tb, rom, sizeof(rom));
+        }
+        else {
+            tscodecPutVarint(&tb, strlen(sensor[k]));
+            tscodecPutRaw(&tb, sensor[k], strlen(sensor[k]));
+        }
+    }
+
+    tscodecPutVarint(&tb, count);
+    tscodecPutTimes(&tb, ts, count);
+
+    for( k = 0; k < nsensors && tb.len <= size; k++ ) {
+        for( i = 0; i < count; i++ ) {
+            present[i] = 0;
+            for( j = 0; j < pack_info[i].count; j++ ) {
+                if( !strcmp(pack_info[i].reading[j].serial, sensor[k]) ) {
+                    values[i] = pack_info[i].reading[j].mtemper;
+                    present[i] = 1;
+                    break;
+                }
+            }
+        }
+        tscodecPutColumn(&tb, values, present, count);
+    }
+
+    // not logged, batch packets less samples when it's too large
+    return tscodecEnd(&tb) < 0 ? -2 : tb.len;
+}
+
+
+/*	description:	packet segment data into time series columns, same as one sample batch
+ *	 input args:	
+ *					$pack_info : struct whitch store segment data
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: success
+ */
+int packetTsData(pack_info_t *pack_info, char *pack_buf, int size) {
+
+    int             bytes = packetTsBatch(pack_info, 1, pack_buf, size);
+
+    if( bytes == -2 ) {
+        logError("packet buffer size[%d] is too small\n", size);
+    }
+
+    return bytes;
+}
+
+
+/*	description:	decode time series packet from packetTsBatch(), for the consumer side
+ *	 input args:	
+ *                  $pack_buf  : time series packet
+ *                  $bytes     : time series packet bytes
+ *					$pack_info : samples output, sample_time is not filled
+ *					$max       : samples output buffer count
+ * return value:    <0: failure   >=0: samples decoded
+ */
+int packetTsDecode(const char *pack_buf, int bytes, pack_info_t *pack_info, int max) {
+
+    int                     i;
+    int                     k;
+    int                     n;
+    int                     outputs;
+    uint64_t                value;
+    uint64_t                nsensors;
+    uint64_t                count;
+    const unsigned char     *data;
+    const unsigned char     *devid;
+    char                    sensor[PACK_MAX_SENSORS][DS18B20_SN_LEN];
+    int64_t                 ts[PACK_TS_MAX_SAMPLES];
+    int                     values[PACK_TS_MAX_SAMPLES];
+    unsigned char           present[PACK_TS_MAX_SAMPLES];
+    tscodec_buf_t           tb;
+
+    // check input args
+    if( !pack_buf || bytes <= 0 || !pack_info || max <= 0 ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    tscodecInit(&tb, (void *)pack_buf, bytes);
+    if( tscodecGetRaw(&tb, &data, 2) < 0 || memcmp(data, PACK_TS_MAGIC, 2) ) {
+        return -2;
+    }
+    if( tscodecGetVarint(&tb, &value) < 0 || value != PACK_TS_VERSION ) {
+        return -3;
+    }
+    if( tscodecGetVarint(&tb, &value) < 0 || value >= DEVID_LEN || tscodecGetRaw(&tb, &devid, (int)value) < 0 ) {
+        return -4;
+    }
+    n = (int)value;
+
+    if( tscodecGetVarint(&tb, &nsensors) < 0 || nsensors > PACK_MAX_SENSORS ) {
+        return -5;
+    }
+    for( k = 0; k < (int)nsensors; k++ ) {
+        if( tscodecGetVarint(&tb, &value) < 0 || value >= DS18B20_SN_LEN ) {
+            return -6;
+        }
+        memset(sensor[k], 0, sizeof(sensor[k]));
+        if( !value ) {
+            if( tscodecGetRaw(&tb, &data, PACK_ROM_LEN) < 0 ) {
+                return -6;
+            }
+            packetRomToSerial(data, sensor[k]);
+        }
+        else {
+            if( tscodecGetRaw(&tb, &data, (int)value) < 0 ) {
+                return -6;
+            }
+            memcpy(sensor[k], data, value);
+        }
+    }
+
+    if( tscodecGetVarint(&tb, &count) < 0 || count < 1 || count > PACK_TS_MAX_SAMPLES || tscodecGetTimes(&tb, ts, (int)count) < 0 ) {
+        return -7;
+    }
+    // samples beyond output buffer are skipped
+    outputs = count < (uint64_t)max ? (int)count : max;
+
+    for( i = 0; i < outputs; i++ ) {
+        memset(&pack_info[i], 0, sizeof(pack_info[i]));
+        memcpy(pack_info[i].devid, devid, n);
+        pack_info[i].sample_ms = ts[i];
+    }
+
+    // value columns fill every sample's readings in sensors table order
+    for( k = 0; k < (int)nsensors; k++ ) {
+        if( tscodecGetColumn(&tb, values, present, (int)count) < 0 ) {
+            return -8;
+        }
+        for( i = 0; i < outputs; i++ ) {
+            if( present[i] ) {
+                strcpy(pack_info[i].reading[pack_info[i].count].serial, sensor[k]);
+                pack_info[i].reading[pack_info[i].count].mtemper = values[i];
+                pack_info[i].count++;
+            }
+        }
+    }
+
+    return outputs;
+}
+
+
+/*	description:	get time of first sample in time series packet, database keys stored
+ *                  packets on it so retention follows sample time instead of push time
+ *	 input args:	
+ *                  $pack_buf  : time series packet
+ *                  $bytes     : time series packet bytes
+ * return value:    0: not a time series packet   >0: first sample time, epoch milliseconds
+ */
+int64_t packetTsTime(const void *pack_buf, int bytes) {
+
+    pack_info_t     first;
+
+    if( packetTsDecode(pack_buf, bytes, &first, 1) <= 0 ) {
+        return 0;
+    }
+
+    return first.sample_ms > 0 ? first.sample_ms : 0;
+}
+
+
+/*	description:	thin samples of time series packet older than a time to first sample of
+ *                  every interval, for database retention
+ *	 input args:	
+ *                  $pack_buf  : time series packet
+ *                  $bytes     : time series packet bytes
+ *                  $before    : epoch milliseconds, samples since then are kept
+ *                  $interval  : milliseconds, first sample of every interval is kept, 0 means
+ *                               remove all samples before $before
+ *                  $bucket    : interval of last sample kept, it goes on from previous packet
+ *                  $thin_buf  : buffer whitch will store thinned packet
+ *                  $size      : buffer size
+ * return value:    <0: not a time series packet   0: no sample left
+ *                  $bytes: packet is kept as it is   others: thinned packet bytes in $thin_buf
+ */
+int packetTsThin(const void *pack_buf, int bytes, int64_t before, int64_t interval, int64_t *bucket, void *thin_buf, int size) {
+
+    static pack_info_t      samples[PACK_TS_MAX_SAMPLES];
+    int                     count;
+    int                     kept = 0;
+    int                     i;
+    int                     rv;
+
+    if( (count = packetTsDecode(pack_buf, bytes, samples, PACK_TS_MAX_SAMPLES)) <= 0 ) {
+        return -1;
+    }
+
+    for( i = 0; i < count; i++ ) {
+        if( samples[i].sample_ms < before ) {
+            if( !interval || samples[i].sample_ms / interval == *bucket ) {
+                continue;
+            }
+            *bucket = samples[i].sample_ms / interval;
+        }
+        if( kept != i ) {
+            samples[kept] = samples[i];
+        }
+        kept++;
+    }
+
+    if( kept == count ) {
+        return bytes;
+    }
+    if( !kept ) {
+        return 0;
+    }
+
+    // deltas of fewer samples may be wider, packet is kept when it doesn't get smaller
+    rv = packetTsBatch(samples, kept, thin_buf, size);
+
+    return (rv > 0 && rv < bytes) ? rv : bytes;
 }
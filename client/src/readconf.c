@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "readconf.h"
+#include "database.h"
 #include "logger.h"
 
 
@@ -73,6 +74,10 @@ int readConf(char *confile, conf_t *conf) {
         	flag = 3;
         	continue;
         }
+        else if( !strcmp(line, "[database]") ) {
+        	flag = 4;
+        	continue;
+        }
 
         // read key and value
         if( flag ) {
@@ -95,6 +100,17 @@ int readConf(char *confile, conf_t *conf) {
                 else if( !strcmp(key, "ds18b20") ) {
                     conf->ds18b20 = atoi(value);
                 }
+                else if( !strcmp(key, "w1path") ) {
+                    strncpy(conf->w1path, value, sizeof(conf->w1path) - 1);
+                }
+                else if( !strcmp(key, "resolution") ) {
+                    conf->resolution = atoi(value);
+                }
+                else if( !strncmp(key, "resolution:", 11) && conf->nres < CONF_MAX_RESOLUTION ) {
+                    strncpy(conf->res[conf->nres].serial, key + 11, sizeof(conf->res[conf->nres].serial) - 1);
+                    conf->res[conf->nres].bits = atoi(value);
+                    conf->nres++;
+                }
                 else {
                     logError("invalid key whitch is not been allowed in this section\n");
                     flag = -3;
@@ -134,14 +150,82 @@ int readConf(char *confile, conf_t *conf) {
             	if( !strcmp(key, "pubtopic") ) {
             		strncpy(conf->pubtopic, value, sizeof(conf->pubtopic));
             	}
+            	else if( !strcmp(key, "histopic") ) {
+            		strncpy(conf->histopic, value, sizeof(conf->histopic));
+            	}
+            	else if( !strcmp(key, "format") ) {
+            		conf->format = !strcmp(value, "cbor") ? CONF_FORMAT_CBOR : !strcmp(value, "ts") ? CONF_FORMAT_TS : CONF_FORMAT_JSON;
+            	}
             	else if( !strcmp(key, "QoS") ) {
             		conf->qos = atoi(value);
             	}
             	else if( !strcmp(key, "keepalive") ) {
             		conf->keepalive = atoi(value);
             	}
+            	else if( !strcmp(key, "inflight") ) {
+            		conf->inflight = atoi(value);
+            	}
+            	else if( !strcmp(key, "backfillwindow") ) {
+            		conf->backfillwindow = atoi(value);
+            	}
+            	else if( !strcmp(key, "backfillrate") ) {
+            		conf->backfillrate = atoi(value);
+            	}
             	else if( !strcmp(key, "readtime") ) {
-            		conf->readtime = atoi(value);
+            		// "500ms" means milliseconds, plain number means seconds
+            		conf->readtime = strstr(value, "ms") ? atoi(value) : atoi(value) * 1000;
+            	}
+            	else if( !strcmp(key, "batchcount") ) {
+            		conf->batchcount = atoi(value);
+            	}
+            	else if( !strcmp(key, "batchbytes") ) {
+            		conf->batchbytes = atoi(value);
+            	}
+            	else if( !strcmp(key, "batchlinger") ) {
+            		conf->batchlinger = strstr(value, "ms") ? atoi(value) : atoi(value) * 1000;
+            	}
+            }
+
+            // read database config
+            else if( (key && value) && (flag == 4) ) {
+            	if( !strcmp(key, "backend") ) {
+            		conf->dbbackend = !strcmp(value, "segment") ? DATABASE_BACKEND_SEGMENT : DATABASE_BACKEND_SQLITE;
+            	}
+            	else if( !strcmp(key, "synchronous") ) {
+            		conf->dbsync = !strcmp(value, "off") ? DATABASE_SYNC_OFF : !strcmp(value, "full") ? DATABASE_SYNC_FULL : DATABASE_SYNC_NORMAL;
+            	}
+            	else if( !strcmp(key, "commitrows") ) {
+            		conf->dbcommitrows = atoi(value);
+            	}
+            	else if( !strcmp(key, "committime") ) {
+            		conf->dbcommittime = strstr(value, "ms") ? atoi(value) : atoi(value) * 1000;
+            	}
+            	else if( !strcmp(key, "ringbytes") ) {
+            		conf->dbringbytes = atoi(value);
+            	}
+            	else if( !strcmp(key, "ringtime") ) {
+            		conf->dbringtime = strstr(value, "ms") ? atoi(value) : atoi(value) * 1000;
+            	}
+            	else if( !strcmp(key, "maxrows") ) {
+            		conf->dbmaxrows = atoll(value);
+            	}
+            	else if( !strcmp(key, "maxbytes") ) {
+            		conf->dbmaxbytes = atoll(value);
+            	}
+            	else if( !strcmp(key, "maxage") ) {
+            		conf->dbmaxage = atoi(value);
+            	}
+            	else if( !strncmp(key, "thin:", 5) && conf->nthin < CONF_MAX_THIN ) {
+            		conf->thin[conf->nthin].age = atoi(key + 5);
+            		conf->thin[conf->nthin].interval = atoi(value);
+            		if( conf->thin[conf->nthin].age > 0 && conf->thin[conf->nthin].interval > 0 ) {
+            			conf->nthin++;
+            		}
+            	}
+            	else {
+            		logError("invalid key whitch is not been allowed in this section\n");
+                    flag = -3;
+                    goto Cleanup;
             	}
             }
             else {
@@ -0,0 +1,370 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  sampler.c
+ *    Description:  This file is a sampler thread function file. Slow sensor
+ *                  reads run in their own thread, so they never stall MQTT
+ *                  publishing or database backlog drain.
+ *                 
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 00时51分56秒"
+ *                 
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "sampler.h"
+#include "ds18b20.h"
+#include "process.h"
+#include "logger.h"
+#include "clock.h"
+
+/* how long samplerStop() waits over the collect deadline of ds18b20 readings, a sample
+ * cycle blocks for ceil(sensors / workers) conversion times plus margin, and a rescan
+ * in that cycle may add sensors the last deadline doesn't count
+ */
+#define SAMPLER_STOP_MARGIN_MS  2000
+
+static struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;               // signaled when sampler thread exit
+    int                 stop;               // 1 means sampler thread should exit
+    int                 running;            // 1 means sampler thread is running
+    int                 timer_fd;           // sample tick timer, owned by sampler thread
+    int64_t             offset_ms;          // wall clock minus monotonic clock when timer armed
+    int                 collect_ms;         // longest time a sample cycle blocks in ds18b20 reading
+    int                 event_fd;           // readable when queue has samples
+    int                 head;               // oldest sample in queue
+    int                 count;              // samples in queue
+    pack_info_t         queue[SAMPLER_QUEUE_LEN];
+    sampler_stats_t     stats;
+} sampler = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, .timer_fd = -1, .event_fd = -1 };
+
+
+/*	description:	check whether sampler thread should exit
+ * return value:    1: stop   0: continue
+ */
+static int samplerStopping(void) {
+
+    int                 stop;
+
+    pthread_mutex_lock(&sampler.lock);
+    stop = sampler.stop;
+    pthread_mutex_unlock(&sampler.lock);
+
+    return stop;
+}
+
+
+/*	description:	push one sample into queue, drop the oldest one if queue is full
+ *	 input args:	
+ *					$pack_info : sample
+ */
+static void samplerPush(pack_info_t *pack_info) {
+
+    pthread_mutex_lock(&sampler.lock);
+
+    if( sampler.count == SAMPLER_QUEUE_LEN ) {
+        sampler.head = (sampler.head + 1) % SAMPLER_QUEUE_LEN;
+        sampler.count--;
+        sampler.stats.dropped++;
+    }
+    memcpy(&sampler.queue[(sampler.head + sampler.count) % SAMPLER_QUEUE_LEN], pack_info, sizeof(*pack_info));
+    sampler.count++;
+    sampler.stats.samples++;
+
+    pthread_mutex_unlock(&sampler.lock);
+
+    // wake up publisher
+    eventfd_write(sampler.event_fd, 1);
+
+    return;
+}
+
+
+/*	description:	arm sample tick timer on absolute monotonic deadlines, first tick is
+ *                  phase aligned to a multiple of $interval on wall clock, so boards
+ *                  sampling at the same rate tick at the same moments
+ *	 input args:	
+ *					$interval : sample interval in milliseconds
+ *					$tick_ms  : wall clock time of first tick output
+ * return value:    <0: failure   0: success
+ */
+static int samplerArmTimer(int interval, int64_t *tick_ms) {
+
+    struct itimerspec   its = {{0}};
+    int64_t             now_real = clockNowMs();
+    int64_t             first = clockMonoMs() + interval - now_real % interval;
+
+    *tick_ms = now_real + interval - now_real % interval;
+    sampler.offset_ms = now_real - clockMonoMs();
+
+    its.it_value.tv_sec = first / 1000;
+    its.it_value.tv_nsec = (first % 1000) * 1000000;
+    its.it_interval.tv_sec = interval / 1000;
+    its.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+
+    if( timerfd_settime(sampler.timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0 ) {
+        logError("arm sample timer failure: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*	description:	keep the longest time a sample cycle blocks on current sensors, so
+ *                  samplerStop() waits long enough, called by sampler thread only
+ */
+static void samplerCollectMs(void) {
+
+    int                 ms = ds18b20CollectMs(PACK_MAX_SENSORS);
+
+    pthread_mutex_lock(&sampler.lock);
+    sampler.collect_ms = ms;
+    pthread_mutex_unlock(&sampler.lock);
+
+    return;
+}
+
+
+/*	description:	sampler thread body
+ *	 input args:	
+ *					$thread_arg : client configurations
+ */
+static void *samplerWorker(void *thread_arg) {
+
+    conf_t              *conf = (conf_t *)thread_arg;
+    pack_info_t         pack_info;
+    int                 interval = conf->readtime > 0 ? conf->readtime : 1000;
+    int64_t             tick_ms = 0;
+    uint64_t            expirations = 0;
+    int                 rv;
+
+    // this thread owns sensor registry
+    if( ds18b20Init(conf->w1path) < 0 ) {
+    	logWarn("no ds18b20 sensor found yet, will rescan w1 bus later\n");
+    }
+    samplerCollectMs();
+
+    if( samplerArmTimer(interval, &tick_ms) < 0 ) {
+        goto Cleanup;
+    }
+
+    // timer keeps ticking while we sample, so samples never drift
+    while( read(sampler.timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations) ) {
+
+        if( samplerStopping() ) {
+            break;
+        }
+
+        // sample took longer than interval, skipped ticks are counted as overruns
+        if( expirations > 1 ) {
+            logWarn("sampler overrun, %llu ticks missed\n", (unsigned long long)(expirations - 1));
+            pthread_mutex_lock(&sampler.lock);
+            sampler.stats.overruns += expirations - 1;
+            pthread_mutex_unlock(&sampler.lock);
+        }
+        tick_ms += (int64_t)interval * (expirations - 1);
+
+        /* wall clock stepped, follow it. Only the offset between wall clock and
+         * monotonic clock tells a step, a late read after overrun doesn't move it
+         */
+        if( llabs(clockNowMs() - clockMonoMs() - sampler.offset_ms) > interval / 2 ) {
+            logWarn("wall clock stepped, realign sample ticks\n");
+            pthread_mutex_lock(&sampler.lock);
+            sampler.stats.steps++;
+            pthread_mutex_unlock(&sampler.lock);
+            if( samplerArmTimer(interval, &tick_ms) < 0 ) {
+                break;
+            }
+            continue;
+        }
+        logDebug("start sample DS18B20 termperature\n");
+
+        memset(&pack_info, 0, sizeof(pack_info));
+
+        // stamp the sample with it's tick, samples are evenly spaced
+        pack_info.sample_ms = tick_ms;
+        tick_ms += interval;
+        clockLocalStr(pack_info.sample_ms, pack_info.sample_time, TIME_LEN);
+        strncpy(pack_info.devid, conf->deviceid, sizeof(pack_info.devid) - 1);
+
+        // read every ds18b20 temper on w1 bus
+        if( (rv = ds18b20GetTemperatures(pack_info.reading, PACK_MAX_SENSORS)) < 0 ) {
+            logError("sample DS18B20 temperature failure, errcode = %d\n", rv);
+            pthread_mutex_lock(&sampler.lock);
+            sampler.stats.failures++;
+            pthread_mutex_unlock(&sampler.lock);
+            continue;
+        }
+        pack_info.count = rv;
+        samplerCollectMs();
+        logInfo("sample DS18B20 termperature success, %d sensors, first temper = %.3f oC\n", pack_info.count, pack_info.reading[0].mtemper / 1000.0);
+
+        samplerPush(&pack_info);
+    }
+
+ Cleanup:
+    ds18b20Term();
+
+    pthread_mutex_lock(&sampler.lock);
+    close(sampler.timer_fd);
+    sampler.timer_fd = -1;
+    sampler.running = 0;
+    pthread_cond_signal(&sampler.cond);
+    pthread_mutex_unlock(&sampler.lock);
+
+    return NULL;
+}
+
+
+/*	description:	start sampler thread, it owns ds18b20 sensor registry and puts
+ *                  timestamped readings into a bounded queue every $conf->readtime
+ *	 input args:	
+ *					$conf : client configurations
+ * return value:    <0: failure   0: success
+ */
+int samplerStart(conf_t *conf) {
+
+    pthread_t           tid;
+
+    // check input args
+    if( !conf ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
+    }
+
+    sampler.stop = 0;
+    sampler.running = 1;
+
+    if( sampler.event_fd < 0 && (sampler.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 ) {
+        logError("create sampler eventfd failure: %s\n", strerror(errno));
+        sampler.running = 0;
+        return -2;
+    }
+
+    if( (sampler.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0 ) {
+        logError("create sample timer failure: %s\n", strerror(errno));
+        sampler.running = 0;
+        return -2;
+    }
+
+    if( threadStart(&tid, samplerWorker, conf) ) {
+        logError("start sampler thread failure\n");
+        close(sampler.timer_fd);
+        sampler.timer_fd = -1;
+        sampler.running = 0;
+        return -3;
+    }
+
+    return 0;
+}
+
+
+/*	description:	stop sampler thread and wait it exit, sample cycle in progress is waited
+ *                  for as long as it's ds18b20 collect deadline
+ * return value:    <0: sampler thread didn't exit in time   0: success
+ */
+int samplerStop(void) {
+
+    struct timespec     deadline;
+    struct itimerspec   its = {{0}};
+    int                 timeout_ms;
+    int                 rv = 0;
+
+    pthread_mutex_lock(&sampler.lock);
+    sampler.stop = 1;
+
+    timeout_ms = sampler.collect_ms + SAMPLER_STOP_MARGIN_MS;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if( deadline.tv_nsec >= 1000000000L ) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    // fire the tick timer right now to wake sampler thread up
+    if( sampler.timer_fd >= 0 ) {
+        its.it_value.tv_nsec = 1;
+        timerfd_settime(sampler.timer_fd, 0, &its, NULL);
+    }
+
+    while( sampler.running ) {
+        if( pthread_cond_timedwait(&sampler.cond, &sampler.lock, &deadline) == ETIMEDOUT ) {
+            logError("sampler thread didn't exit in %d ms\n", timeout_ms);
+            rv = -1;
+            break;
+        }
+    }
+    logInfo("sampler stats: samples %lu, failures %lu, overruns %lu, steps %lu, dropped %lu\n", sampler.stats.samples,
+                sampler.stats.failures, sampler.stats.overruns, sampler.stats.steps, sampler.stats.dropped);
+    pthread_mutex_unlock(&sampler.lock);
+
+    return rv;
+}
+
+
+/*	description:	pop the oldest sample from queue, never blocks
+ *	 input args:	
+ *					$pack_info : sample output
+ * return value:    <0: queue is empty   0: success
+ */
+int samplerPop(pack_info_t *pack_info) {
+
+    int                 rv = -1;
+
+    if( !pack_info ) {
+        return -2;
+    }
+
+    pthread_mutex_lock(&sampler.lock);
+    if( sampler.count ) {
+        memcpy(pack_info, &sampler.queue[sampler.head], sizeof(*pack_info));
+        sampler.head = (sampler.head + 1) % SAMPLER_QUEUE_LEN;
+        sampler.count--;
+        rv = 0;
+    }
+    pthread_mutex_unlock(&sampler.lock);
+
+    return rv;
+}
+
+
+/*	description:	get sampler statistics
+ *	 input args:	
+ *					$stats : statistics output
+ */
+void samplerGetStats(sampler_stats_t *stats) {
+
+    if( !stats ) {
+        return;
+    }
+
+    pthread_mutex_lock(&sampler.lock);
+    memcpy(stats, &sampler.stats, sizeof(*stats));
+    pthread_mutex_unlock(&sampler.lock);
+
+    return;
+}
+
+
+/*	description:	get sampler eventfd, it's readable when queue has samples. Read it to
+ *                  clear before popping samples
+ * return value:    <0: sampler not started   >=0: eventfd
+ */
+int samplerEventFd(void) {
+
+    return sampler.event_fd;
+}
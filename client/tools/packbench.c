@@ -0,0 +1,177 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  packbench.c
+ *    Description:  This file is a packet micro benchmark, it times json
+ *                  templates of every platform, single sample and batch,
+ *                  next to CBOR and time series packets of the same samples.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时52分08秒"
+ *
+ * Usage:
+ *
+ *          make packbench && ./packbench -n 1000000 -s 4 -b 10
+ *
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <libgen.h>
+
+#include "packet.h"
+
+static const char   *platform_name[] = { "", "Huawei", "Aliyun", "Tencent" };
+
+
+// print help information
+static void printUsage(char *progname) {
+
+    printf("Usage: %s [OPTION]...\n", progname);
+    printf(" %s times packet functions on fixed samples\n", progname);
+    printf("\nMandatory arguments to long options are mandatory for short options too:\n");
+    printf("-n(--loops)    : packet calls of each function, default 1000000\n");
+    printf("-s(--sensors)  : sensors in each sample, default 4\n");
+    printf("-b(--batch)    : samples in each batch, default 10\n");
+    printf("-h(--help)     : display this help information\n");
+    return;
+}
+
+
+/*	description:	get current time in nanoseconds from monotonic clock */
+static double nowNs(void) {
+
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*	description:	time one batch packet function
+ *	 input args:
+ *					$name      : function name to print
+ *					$func      : batch packet function
+ *					$pack_info : samples, changed every loop so nothing is cached
+ *					$count     : samples count
+ *					$loops     : packet calls
+ */
+static void benchBatch(const char *name, packBatchFunc func, pack_info_t *pack_info, int count, long loops) {
+
+    static char     pack_buf[PACK_BUF_LEN];
+    double          start = nowNs();
+    long            bytes = 0;
+    int             rv;
+    long            i;
+
+    for( i = 0; i < loops; i++ ) {
+        pack_info[0].reading[0].mtemper = i % 100000;
+        if( (rv = func(pack_info, count, pack_buf, sizeof(pack_buf))) < 0 ) {
+            printf("%-24s packet failure, errcode = %d\n", name, rv);
+            return;
+        }
+        bytes += rv;
+    }
+
+    printf("%-24s %8.1f ns/msg %6ld bytes/msg\n", name, (nowNs() - start) / loops, bytes / loops);
+
+    return;
+}
+
+
+int main(int argc, char *argv[]) {
+
+    static pack_info_t  pack_info[PACK_TS_MAX_SAMPLES];
+    static char         pack_buf[PACK_BUF_LEN];
+    char                *progname = NULL;
+    char                name[32];
+    long                loops = 1000000;
+    int                 sensors = 4;
+    int                 count = 10;
+    double              start;
+    long                bytes;
+    int                 platform;
+    int                 rv;
+    long                i;
+    int                 j;
+
+    struct option       opts[] = {
+                            {"loops", required_argument, NULL, 'n'},
+                            {"sensors", required_argument, NULL, 's'},
+                            {"batch", required_argument, NULL, 'b'},
+                            {"help", no_argument, NULL, 'h'},
+                            {NULL, 0, NULL, 0}
+                        };
+
+    progname = (char *)basename(argv[0]);
+    while( (rv = getopt_long(argc, argv, "n:s:b:h", opts, NULL)) != -1 ) {
+        switch(rv) {
+
+            case 'n':
+                loops = atol(optarg);
+                break;
+
+            case 's':
+                sensors = atoi(optarg);
+                break;
+
+            case 'b':
+                count = atoi(optarg);
+                break;
+
+            case 'h':
+                printUsage(progname);
+                return 0;
+
+            default:
+                break;
+        }
+    }
+
+    if( loops <= 0 || sensors <= 0 || sensors > PACK_MAX_SENSORS || count <= 0 || count > PACK_TS_MAX_SAMPLES ) {
+        printUsage(progname);
+        return -1;
+    }
+
+    for( i = 0; i < count; i++ ) {
+        strcpy(pack_info[i].devid, "rpi4B#01");
+        strcpy(pack_info[i].sample_time, "2024-04-17 12:00:00");
+        pack_info[i].sample_ms = 1713355200123LL + i * 1000;
+        pack_info[i].count = sensors;
+        for( j = 0; j < sensors; j++ ) {
+            snprintf(pack_info[i].reading[j].serial, sizeof(pack_info[i].reading[j].serial), "28-%012x", j);
+            pack_info[i].reading[j].mtemper = 23456 - j * 1111 + (int)i * 7;
+        }
+    }
+
+    printf("%ld loops, %d sensors, batch of %d samples\n", loops, sensors, count);
+
+    for( platform = 1; platform <= 3; platform++ ) {
+        packetInit(platform);
+
+        start = nowNs();
+        for( i = 0, bytes = 0; i < loops; i++ ) {
+            pack_info[0].reading[0].mtemper = i % 100000;
+            if( (rv = packetJsonData(pack_info, pack_buf, sizeof(pack_buf))) < 0 ) {
+                printf("%s packet failure, errcode = %d\n", platform_name[platform], rv);
+                return -2;
+            }
+            bytes += rv;
+        }
+        snprintf(name, sizeof(name), "%s json", platform_name[platform]);
+        printf("%-24s %8.1f ns/msg %6ld bytes/msg\n", name, (nowNs() - start) / loops, bytes / loops);
+
+        snprintf(name, sizeof(name), "%s json batch", platform_name[platform]);
+        benchBatch(name, packetJsonBatch, pack_info, count, loops);
+    }
+
+    benchBatch("cbor batch", packetCborBatch, pack_info, count, loops);
+    benchBatch("time series batch", packetTsBatch, pack_info, count, loops);
+
+    return 0;
+}
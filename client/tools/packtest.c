@@ -0,0 +1,219 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  packtest.c
+ *    Description:  This file is a packet golden test, it packets fixed samples
+ *                  for Huawei, Aliyun and Tencent, single and batch, and
+ *                  compares them byte for byte with fixed expected messages,
+ *                  then checks a buffer one byte short is refused.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时52分08秒"
+ *
+ * Usage:
+ *
+ *          make packtest
+ *
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packet.h"
+
+// samples and sensors of fixture
+#define FIXTURE_SAMPLES     3
+#define FIXTURE_SENSORS     4
+
+// guard bytes after a too small buffer, must stay untouched
+#define GUARD_BYTES         16
+#define GUARD_CHAR          0x5a
+
+typedef struct golden_s
+{
+    int             platform;           // 1 means HW, 2 means AL, 3 means TX, 0 means segment text
+    const char      *name;              // case name
+    int             count;              // samples packeted
+    const char      *expect;            // expected message
+} golden_t;
+
+static const char   *fixture_serial[FIXTURE_SENSORS] = {
+                        "28-0316a2797e0a", "28-0316a27a1b2c", "28-0416b1c2d3e4", "28-0516c3d4e5f6"
+                    };
+
+// negative values, values round half away from zero, range limits
+static const int    fixture_mtemper[FIXTURE_SAMPLES][FIXTURE_SENSORS] = {
+                        { 23456, -1250, -5, 100005 },
+                        { 23454, -4, 5, -55000 },
+                        { 23455, 999, -999, 125000 }
+                    };
+
+static const golden_t golden[] = {
+    { 1, "single", 1,
+              "{\"services\": [{\"service_id\": \"1\",\"properties\": {\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}]}}]}" },
+    { 1, "batch of 1", 1,
+              "{\"services\": [{\"service_id\": \"1\",\"properties\": {\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}]}}]}" },
+    { 1, "batch of 3", 3,
+              "{\"services\": [{\"service_id\": \"1\",\"properties\": {\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}]},\"event_time\": \"20240417T120000Z\"},"
+              "{\"service_id\": \"1\",\"properties\": {\"temperature\": 23.45,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.45},{\"id\": \"28-0316a27a1b2c\",\"temperature\": 0.00},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": 0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": -55.00}]},\"event_time\": \"20240417T120100Z\"},"
+              "{\"service_id\": \"1\",\"properties\": {\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": 1.00},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -1.00},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 125.00}]},\"event_time\": \"20240417T120200Z\"}]}" },
+    { 2, "single", 1,
+              "{\"params\": {\"temperature\": 23.46,\"sensors\": [{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},"
+              "{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}]}}" },
+    { 2, "batch of 1", 1,
+              "{\"params\": {\"temperature\": 23.46,\"sensors\": [{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},"
+              "{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}]}}" },
+    { 2, "batch of 3", 3,
+              "{\"params\": {\"properties\": {\"temperature\": [{\"value\": 23.46,\"time\": 1713355200123},"
+              "{\"value\": 23.45,\"time\": 1713355260123},{\"value\": 23.46,\"time\": 1713355320123}],\"sensors\": ["
+              "{\"value\": [{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},"
+              "{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}],\"time\": 1713355200123},{\"value\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.45},{\"id\": \"28-0316a27a1b2c\",\"temperature\": 0.00},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": 0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": -55.00}],\"time\": 1713355260123},{\"value\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": 1.00},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -1.00},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 125.00}],\"time\": 1713355320123}]}}}" },
+    { 3, "single", 1,
+              "{\"type\": \"update\",\"state\": {\"reported\": {\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}]}},\"version\": 1,   \"clientToken\": \"clientToken\"}" },
+    { 3, "batch of 1", 1,
+              "{\"type\": \"update\",\"state\": {\"reported\": {\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}]}},\"version\": 1,   \"clientToken\": \"clientToken\"}" },
+    { 3, "batch of 3", 3,
+              "{\"type\": \"update\",\"state\": {\"reported\": {\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": 1.00},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -1.00},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 125.00}],\"samples\": ["
+              "{\"timestamp\": 1713355200123,\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": -1.25},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -0.01},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 100.01}]},"
+              "{\"timestamp\": 1713355260123,\"temperature\": 23.45,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.45},{\"id\": \"28-0316a27a1b2c\",\"temperature\": 0.00},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": 0.01},{\"id\": \"28-0516c3d4e5f6\",\"temperature\": -55.00}]},"
+              "{\"timestamp\": 1713355320123,\"temperature\": 23.46,\"sensors\": ["
+              "{\"id\": \"28-0316a2797e0a\",\"temperature\": 23.46},{\"id\": \"28-0316a27a1b2c\",\"temperature\": 1.00},"
+              "{\"id\": \"28-0416b1c2d3e4\",\"temperature\": -1.00},"
+              "{\"id\": \"28-0516c3d4e5f6\",\"temperature\": 125.00}]}]}},\"version\": 1,   \"clientToken\": \"clientToken\"}" },
+    { 0, "segment", 1,
+              "rpi4B#01,2024-04-17 12:00:00,28-0316a2797e0a:23.46,28-0316a27a1b2c:-1.25,28-0416b1c2d3e4:-0.01,"
+              "28-0516c3d4e5f6:100.01" },
+};
+
+
+/*	description:	build fixture samples, one minute apart
+ *	 input args:	
+ *					$pack_info : samples output, FIXTURE_SAMPLES
+ */
+static void buildFixture(pack_info_t *pack_info) {
+
+    int             i, j;
+
+    memset(pack_info, 0, FIXTURE_SAMPLES * sizeof(*pack_info));
+    for( i = 0; i < FIXTURE_SAMPLES; i++ ) {
+        strcpy(pack_info[i].devid, "rpi4B#01");
+        strcpy(pack_info[i].sample_time, "2024-04-17 12:00:00");
+        pack_info[i].sample_ms = 1713355200123LL + i * 60000;
+        pack_info[i].count = FIXTURE_SENSORS;
+        for( j = 0; j < FIXTURE_SENSORS; j++ ) {
+            strcpy(pack_info[i].reading[j].serial, fixture_serial[j]);
+            pack_info[i].reading[j].mtemper = fixture_mtemper[i][j];
+        }
+    }
+
+    return;
+}
+
+
+/*	description:	packet samples the way golden case says
+ *	 input args:	
+ *					$gold      : golden case
+ *					$pack_info : samples
+ *                  $pack_buf  : buffer whitch will store packeted data
+ *                  $size      : buffer size 
+ * return value:    <0: failure   >0: packeted bytes
+ */
+static int packGolden(const golden_t *gold, pack_info_t *pack_info, char *pack_buf, int size) {
+
+    if( !gold->platform ) {
+        return packetSegmentData(pack_info, pack_buf, size);
+    }
+
+    packetInit(gold->platform);
+    if( !strcmp(gold->name, "single") ) {
+        return packetJsonData(pack_info, pack_buf, size);
+    }
+
+    return packetJsonBatch(pack_info, gold->count, pack_buf, size);
+}
+
+
+int main(int argc, char *argv[]) {
+
+    static char     pack_buf[PACK_BUF_LEN];
+    pack_info_t     pack_info[FIXTURE_SAMPLES];
+    int             expect_bytes;
+    int             failures = 0;
+    int             bytes;
+    int             i, j;
+
+    buildFixture(pack_info);
+
+    for( i = 0; i < (int)(sizeof(golden) / sizeof(golden[0])); i++ ) {
+        expect_bytes = strlen(golden[i].expect);
+
+        // whole message must match, and so must the returned length
+        memset(pack_buf, 0, sizeof(pack_buf));
+        bytes = packGolden(&golden[i], pack_info, pack_buf, sizeof(pack_buf));
+        if( bytes != expect_bytes || strcmp(pack_buf, golden[i].expect) ) {
+            for( j = 0; pack_buf[j] && pack_buf[j] == golden[i].expect[j]; j++ );
+            printf("FAIL platform %d %s: %d bytes, expect %d, differs at %d\n", golden[i].platform, golden[i].name, bytes, expect_bytes, j);
+            printf("   got: %s\nexpect: %s\n", pack_buf, golden[i].expect);
+            failures++;
+            continue;
+        }
+
+        // a buffer one byte short fails without writing past it
+        memset(pack_buf, GUARD_CHAR, sizeof(pack_buf));
+        bytes = packGolden(&golden[i], pack_info, pack_buf, expect_bytes);
+        for( j = expect_bytes; j < expect_bytes + GUARD_BYTES && (unsigned char)pack_buf[j] == GUARD_CHAR; j++ );
+        if( bytes >= 0 || j < expect_bytes + GUARD_BYTES ) {
+            printf("FAIL platform %d %s: short buffer returns %d, wrote past it %s\n", golden[i].platform, golden[i].name,
+                        bytes, j < expect_bytes + GUARD_BYTES ? "yes" : "no");
+            failures++;
+            continue;
+        }
+
+        printf("ok   platform %d %s\n", golden[i].platform, golden[i].name);
+    }
+
+    printf("%d golden cases, %d failures\n", i, failures);
+
+    return failures ? 1 : 0;
+}
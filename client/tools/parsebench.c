@@ -0,0 +1,173 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  parsebench.c
+ *    Description:  This file is a w1_slave parser micro benchmark, it compares
+ *                  ds18b20Parse() with the old strstr()/atof() parser on the
+ *                  same w1_slave contents and checks both agree.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时35分20秒"
+ *
+ * Usage:
+ *
+ *          make parsebench && ./parsebench -n 10000000
+ *
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <libgen.h>
+
+#include "ds18b20.h"
+
+// distinct w1_slave contents, temperatures spread over ds18b20 range
+#define SAMPLE_COUNT        256
+
+typedef struct sample_s
+{
+    char            buf[128];           // w1_slave content
+    int             bytes;              // content bytes
+} sample_t;
+
+static sample_t     samples[SAMPLE_COUNT];
+
+
+// print help information
+static void printUsage(char *progname) {
+
+    printf("Usage: %s [OPTION]...\n", progname);
+    printf(" %s compares ds18b20Parse() with the old strstr()/atof() parser\n", progname);
+    printf("\nMandatory arguments to long options are mandatory for short options too:\n");
+    printf("-n(--loops)    : parse calls of each parser, default 10000000\n");
+    printf("-h(--help)     : display this help information\n");
+    return;
+}
+
+
+/*	description:	get current time in nanoseconds from monotonic clock */
+static double nowNs(void) {
+
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*	description:	old parser, find "t=" and convert the rest by atof() */
+static int oldParse(const char *buf, float *temp) {
+
+    const char      *ptr = NULL;
+
+    if( !(ptr = strstr(buf, "t=")) ) {
+        return -1;
+    }
+    *temp = atof(ptr + 2) / 1000;
+
+    return 0;
+}
+
+
+/*	description:	build w1_slave contents from -55.000 to 125.000 degrees */
+static void buildSamples(void) {
+
+    int             mtemper;
+    int             raw;
+    int             i;
+
+    for( i = 0; i < SAMPLE_COUNT; i++ ) {
+        // 12 bits resolution, 1/16 degree per step
+        mtemper = -55000 + i * 180000 / (SAMPLE_COUNT - 1);
+        raw = mtemper * 16 / 1000;
+        mtemper = raw * 1000 / 16;
+        samples[i].bytes = snprintf(samples[i].buf, sizeof(samples[i].buf),
+                "%02x %02x 4b 46 7f ff 0c 10 57 : crc=57 YES\n%02x %02x 4b 46 7f ff 0c 10 57 t=%d\n",
+                raw & 0xff, (raw >> 8) & 0xff, raw & 0xff, (raw >> 8) & 0xff, mtemper);
+    }
+
+    return;
+}
+
+
+int main(int argc, char *argv[]) {
+
+    char            *progname = NULL;
+    long            loops = 10000000;
+    long            sum = 0;
+    double          start;
+    double          old_ns;
+    double          new_ns;
+    float           temp = 0;
+    int             mtemper = 0;
+    int             rv;
+    long            i;
+
+    struct option   opts[] = {
+                        {"loops", required_argument, NULL, 'n'},
+                        {"help", no_argument, NULL, 'h'},
+                        {NULL, 0, NULL, 0}
+                    };
+
+    progname = (char *)basename(argv[0]);
+    while( (rv = getopt_long(argc, argv, "n:h", opts, NULL)) != -1 ) {
+        switch(rv) {
+
+            case 'n':
+                loops = atol(optarg);
+                break;
+
+            case 'h':
+                printUsage(progname);
+                return 0;
+
+            default:
+                break;
+        }
+    }
+
+    if( loops <= 0 ) {
+        printUsage(progname);
+        return -1;
+    }
+
+    buildSamples();
+
+    // both parsers must agree on every sample before timing means anything
+    for( i = 0; i < SAMPLE_COUNT; i++ ) {
+        if( oldParse(samples[i].buf, &temp) || ds18b20Parse(samples[i].buf, samples[i].bytes, &mtemper) ) {
+            printf("sample %ld parse failure\n", i);
+            return -2;
+        }
+        if( lroundf(temp * 1000) != mtemper ) {
+            printf("sample %ld mismatch: old %.3f new %d\n", i, temp, mtemper);
+            return -3;
+        }
+    }
+
+    start = nowNs();
+    for( i = 0; i < loops; i++ ) {
+        oldParse(samples[i % SAMPLE_COUNT].buf, &temp);
+        sum += (long)temp;
+    }
+    old_ns = (nowNs() - start) / loops;
+
+    start = nowNs();
+    for( i = 0; i < loops; i++ ) {
+        ds18b20Parse(samples[i % SAMPLE_COUNT].buf, samples[i % SAMPLE_COUNT].bytes, &mtemper);
+        sum += mtemper / 1000;
+    }
+    new_ns = (nowNs() - start) / loops;
+
+    printf("strstr/atof  : %8.1f ns/parse\n", old_ns);
+    printf("ds18b20Parse : %8.1f ns/parse (%.1fx)\n", new_ns, old_ns / new_ns);
+
+    // keep the loops from being optimized away
+    return sum == 0x7fffffff;
+}
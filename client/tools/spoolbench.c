@@ -0,0 +1,248 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  spoolbench.c
+ *    Description:  This file is a spool benchmark, it pushes N packets into
+ *                  the database and drains them again in batches the way
+ *                  client backfill does, for sqlite and segment backends.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 02时21分45秒"
+ *
+ * Usage:
+ *
+ *          make spoolbench && ./spoolbench -n 1000000 -b 100 -f /tmp/spoolbench.db
+ *
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <glob.h>
+#include <getopt.h>
+#include <libgen.h>
+
+#include "database.h"
+#include "logger.h"
+
+static const char   *sync_names[] = { "default", "off", "normal", "full" };
+
+
+// print help information
+static void printUsage(char *progname) {
+
+    printf("Usage: %s [OPTION]...\n", progname);
+    printf(" %s pushes packets into spool and drains them, for every backend\n", progname);
+    printf("\nMandatory arguments to long options are mandatory for short options too:\n");
+    printf("-n(--packets)  : packets pushed and drained, default 1000000\n");
+    printf("-b(--bytes)    : bytes of each packet, default 100\n");
+    printf("-s(--sync)     : 0 default, 1 off, 2 normal, 3 full, default 0\n");
+    printf("-k(--backend)  : sqlite, segment or both, default both\n");
+    printf("-f(--file)     : spool file name, default /tmp/spoolbench.db\n");
+    printf("-h(--help)     : display this help information\n");
+    return;
+}
+
+
+/*	description:	get current time in seconds from monotonic clock */
+static double nowSec(void) {
+
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*	description:	remove spool files of both backends
+ *	 input args:
+ *					$fname : spool file name
+ */
+static void removeSpool(const char *fname) {
+
+    char                path[256];
+    glob_t              g;
+    size_t              i;
+
+    unlink(fname);
+    snprintf(path, sizeof(path), "%s-wal", fname);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s-shm", fname);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s.cursor", fname);
+    unlink(path);
+
+    snprintf(path, sizeof(path), "%s.*.seg", fname);
+    if( !glob(path, 0, NULL, &g) ) {
+        for( i = 0; i < g.gl_pathc; i++ ) {
+            unlink(g.gl_pathv[i]);
+        }
+        globfree(&g);
+    }
+
+    return;
+}
+
+
+/*	description:	push packets into a fresh spool, then pop and delete them in batches
+ *	 input args:
+ *					$fname   : spool file name
+ *					$backend : DATABASE_BACKEND_*
+ *					$sync    : DATABASE_SYNC_*
+ *					$count   : packets count
+ *					$bytes   : bytes of each packet
+ * return value:    <0: failure   0: success
+ */
+static int benchSpool(char *fname, int backend, int sync, long count, int bytes) {
+
+    static database_pack_t  packs[DATABASE_BATCH_MAX];
+    static char             buf[DATABASE_BATCH_MAX * 4096];
+    database_opt_t          opt = {0};
+    int64_t                 ids[DATABASE_BATCH_MAX];
+    int64_t                 cursor = 0;
+    char                    *pack = NULL;
+    double                  start;
+    double                  push_sec;
+    double                  drain_sec;
+    long                    drained = 0;
+    int                     rv = 0;
+    int                     n;
+    long                    i;
+
+    if( !(pack = calloc(1, bytes)) ) {
+        return -1;
+    }
+
+    removeSpool(fname);
+    opt.backend = backend;
+    opt.sync = sync;
+    if( databaseInit(fname, &opt) < 0 ) {
+        printf("init %s spool failure\n", backend == DATABASE_BACKEND_SEGMENT ? "segment" : "sqlite");
+        free(pack);
+        return -2;
+    }
+
+    start = nowSec();
+    for( i = 0; i < count; i++ ) {
+        memcpy(pack, &i, sizeof(i) < (size_t)bytes ? sizeof(i) : (size_t)bytes);
+        if( databasePushPacket(pack, bytes) < 0 ) {
+            printf("push packet %ld failure\n", i);
+            rv = -3;
+            goto Cleanup;
+        }
+    }
+    databaseFlush(1);
+    databaseCommit(1);
+    push_sec = nowSec() - start;
+
+    // pop after cursor and delete what was popped, as acknowledged backfill does
+    start = nowSec();
+    while( (n = databasePopPackets(cursor, packs, DATABASE_BATCH_MAX, buf, sizeof(buf))) > 0 ) {
+        for( i = 0; i < n; i++ ) {
+            ids[i] = packs[i].id;
+        }
+        if( databaseDelPackets(ids, n) < 0 ) {
+            printf("delete %d packets failure\n", n);
+            rv = -4;
+            goto Cleanup;
+        }
+        cursor = ids[n - 1];
+        drained += n;
+    }
+    databaseCommit(1);
+    drain_sec = nowSec() - start;
+
+    printf("%-8s sync %-7s: push %8.0f packets/s, drain %ld packets %8.0f packets/s\n",
+                backend == DATABASE_BACKEND_SEGMENT ? "segment" : "sqlite", sync_names[sync],
+                count / push_sec, drained, drained / drain_sec);
+    if( drained != count ) {
+        printf("%ld packets pushed but %ld drained\n", count, drained);
+        rv = -5;
+    }
+
+ Cleanup:
+    databaseTerm();
+    removeSpool(fname);
+    free(pack);
+
+    return rv;
+}
+
+
+int main(int argc, char *argv[]) {
+
+    char                *progname = NULL;
+    char                fname[128] = "/tmp/spoolbench.db";
+    char                backend[16] = "both";
+    long                count = 1000000;
+    int                 bytes = 100;
+    int                 sync = DATABASE_SYNC_DEFAULT;
+    int                 rv = 0;
+
+    struct option       opts[] = {
+                            {"packets", required_argument, NULL, 'n'},
+                            {"bytes", required_argument, NULL, 'b'},
+                            {"sync", required_argument, NULL, 's'},
+                            {"backend", required_argument, NULL, 'k'},
+                            {"file", required_argument, NULL, 'f'},
+                            {"help", no_argument, NULL, 'h'},
+                            {NULL, 0, NULL, 0}
+                        };
+
+    progname = (char *)basename(argv[0]);
+    while( (rv = getopt_long(argc, argv, "n:b:s:k:f:h", opts, NULL)) != -1 ) {
+        switch(rv) {
+
+            case 'n':
+                count = atol(optarg);
+                break;
+
+            case 'b':
+                bytes = atoi(optarg);
+                break;
+
+            case 's':
+                sync = atoi(optarg);
+                break;
+
+            case 'k':
+                strncpy(backend, optarg, sizeof(backend) - 1);
+                break;
+
+            case 'f':
+                strncpy(fname, optarg, sizeof(fname) - 1);
+                break;
+
+            case 'h':
+                printUsage(progname);
+                return 0;
+
+            default:
+                break;
+        }
+    }
+
+    if( count <= 0 || bytes <= 0 || bytes > 4096 || sync < DATABASE_SYNC_DEFAULT || sync > DATABASE_SYNC_FULL ) {
+        printUsage(progname);
+        return -1;
+    }
+
+    logInit("console", LOG_ERROR, 10, 0);
+    printf("%ld packets of %d bytes\n", count, bytes);
+
+    rv = 0;
+    if( strcmp(backend, "segment") && benchSpool(fname, DATABASE_BACKEND_SQLITE, sync, count, bytes) < 0 ) {
+        rv = 1;
+    }
+    if( strcmp(backend, "sqlite") && benchSpool(fname, DATABASE_BACKEND_SEGMENT, sync, count, bytes) < 0 ) {
+        rv = 1;
+    }
+
+    logTerm();
+
+    return rv;
+}
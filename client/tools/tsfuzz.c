@@ -0,0 +1,418 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  tsfuzz.c
+ *    Description:  This file is a time series and CBOR codec fuzz test, random
+ *                  samples must survive packetTsBatch() -> packetTsDecode() and
+ *                  packetCborBatch() -> packetCborDecode() unchanged, every
+ *                  smaller buffer must be refused, and every truncated or bit
+ *                  flipped packet must be rejected or decoded within bounds.
+ *                  Build it with sanitizers to catch reads past the packet.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 02时04分37秒"
+ *
+ * Usage:
+ *
+ *          make tsfuzz, or ./tsfuzz -n 100000 -s 1
+ *
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <libgen.h>
+
+#include "packet.h"
+#include "tscodec.h"
+
+// sensors one random batch picks from
+#define FUZZ_MAX_SENSORS    12
+
+// bit flipped copies decoded for every packet
+#define FUZZ_FLIPS          16
+
+// smaller buffers and truncations tried for every packet, larger packets are stepped over
+#define FUZZ_LENGTHS        128
+
+// decode function pointer type, packs consumer side of a batch packet function
+typedef int (*fuzzDecodeFunc)(const char *pack_buf, int bytes, pack_info_t *pack_info, int max);
+
+typedef struct fuzz_codec_s
+{
+    const char      *name;              // codec name to print
+    packBatchFunc   pack;               // batch packet function
+    fuzzDecodeFunc  decode;             // decode function
+    long            damaged;            // bit flipped packets decoded
+    long            accepted;           // bit flipped packets still decoded
+} fuzz_codec_t;
+
+static fuzz_codec_t fuzz_codec[] = {
+                        { "time series", packetTsBatch, packetTsDecode, 0, 0 },
+                        { "cbor", packetCborBatch, packetCborDecode, 0, 0 }
+                    };
+
+static uint64_t     fuzz_state = 1;
+
+
+// print help information
+static void printUsage(char *progname) {
+
+    printf("Usage: %s [OPTION]...\n", progname);
+    printf(" %s round trips random samples through time series and CBOR packets\n", progname);
+    printf("\nMandatory arguments to long options are mandatory for short options too:\n");
+    printf("-n(--loops)    : random batches, default 500\n");
+    printf("-s(--seed)     : random seed, default current time\n");
+    printf("-h(--help)     : display this help information\n");
+    return;
+}
+
+
+/*	description:	xorshift64* random number, reproducible by seed */
+static uint64_t fuzzRand(void) {
+
+    fuzz_state ^= fuzz_state >> 12;
+    fuzz_state ^= fuzz_state << 25;
+    fuzz_state ^= fuzz_state >> 27;
+
+    return fuzz_state * 0x2545F4914F6CDD1DULL;
+}
+
+
+/*	description:	random integer in [min, max] */
+static int64_t fuzzRange(int64_t min, int64_t max) {
+
+    return min + (int64_t)(fuzzRand() % (uint64_t)(max - min + 1));
+}
+
+
+/*	description:	random temperature, mostly ds18b20 range, sometimes far outside it */
+static int fuzzTemper(int last) {
+
+    switch( fuzzRand() % 8 ) {
+        case 0:
+            return (int)fuzzRange(-2147483647 - 1, 2147483647);
+        case 1:
+            return (int)fuzzRange(-55000, 125000);
+        default:
+            // slow moving value, deltas are small
+            return last + (int)fuzzRange(-200, 200);
+    }
+}
+
+
+/*	description:	random timestamp step, regular interval with jitter, gaps and steps back */
+static int64_t fuzzStep(int interval) {
+
+    switch( fuzzRand() % 16 ) {
+        case 0:
+            return fuzzRange(-86400000LL, 86400000LL);
+        case 1:
+            return fuzzRange(-(1LL << 40), 1LL << 40);
+        case 2:
+            return 0;
+        default:
+            return interval + fuzzRange(-20, 20);
+    }
+}
+
+
+/*	description:	build random batch, readings of each sample sorted by serial like the
+ *                  ds18b20 registry keeps them, so decoded order must be the same
+ *	 input args:
+ *					$pack_info : samples output
+ *	 return value:  samples count
+ */
+static int fuzzBatch(pack_info_t *pack_info) {
+
+    char            serial[FUZZ_MAX_SENSORS][DS18B20_SN_LEN];
+    int             mtemper[FUZZ_MAX_SENSORS];
+    int             nsensors = (int)fuzzRange(0, FUZZ_MAX_SENSORS);
+    int             count = (int)fuzzRange(1, PACK_TS_MAX_SAMPLES);
+    int             interval = (int)fuzzRange(1, 600000);
+    int64_t         ts = fuzzRange(-(1LL << 41), 1LL << 42);
+    char            tmp[DS18B20_SN_LEN];
+    int             i, j;
+
+    // w1 form serials are packed as rom bytes, others are sent as text
+    for( j = 0; j < nsensors; j++ ) {
+        if( fuzzRand() % 4 ) {
+            snprintf(serial[j], DS18B20_SN_LEN, "%02x-%012llx", (unsigned)(fuzzRand() % 256),
+                        (unsigned long long)(fuzzRand() & 0xffffffffffffULL));
+        }
+        else {
+            snprintf(serial[j], DS18B20_SN_LEN, "probe-%d", (int)fuzzRange(0, 99999));
+        }
+        mtemper[j] = (int)fuzzRange(-55000, 125000);
+    }
+
+    // sort serials the way ds18b20 registry does
+    for( i = 0; i < nsensors; i++ ) {
+        for( j = i + 1; j < nsensors; j++ ) {
+            if( strcmp(serial[i], serial[j]) > 0 ) {
+                strcpy(tmp, serial[i]);
+                strcpy(serial[i], serial[j]);
+                strcpy(serial[j], tmp);
+            }
+        }
+    }
+
+    // duplicated serial would be one sensor in packet, drop it
+    for( i = 1; i < nsensors; i++ ) {
+        if( !strcmp(serial[i - 1], serial[i]) ) {
+            memmove(serial[i], serial[i + 1], (nsensors - i - 1) * sizeof(serial[0]));
+            nsensors--;
+            i--;
+        }
+    }
+
+    memset(pack_info, 0, count * sizeof(*pack_info));
+    for( i = 0; i < count; i++ ) {
+        snprintf(pack_info[i].devid, DEVID_LEN, "rpi-%d", (int)fuzzRange(0, 99999999));
+        if( i ) {
+            strcpy(pack_info[i].devid, pack_info[0].devid);
+            ts += fuzzStep(interval);
+        }
+        pack_info[i].sample_ms = ts;
+
+        // every sensor may miss some samples
+        for( j = 0; j < nsensors; j++ ) {
+            mtemper[j] = fuzzTemper(mtemper[j]);
+            if( fuzzRand() % 8 ) {
+                strcpy(pack_info[i].reading[pack_info[i].count].serial, serial[j]);
+                pack_info[i].reading[pack_info[i].count].mtemper = mtemper[j];
+                pack_info[i].count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+
+/*	description:	compare decoded samples with original ones
+ * return value:    <0: differs   0: same
+ */
+static int fuzzCompare(pack_info_t *expect, pack_info_t *got, int count) {
+
+    int             i, j;
+
+    for( i = 0; i < count; i++ ) {
+        if( strcmp(expect[i].devid, got[i].devid) || expect[i].sample_ms != got[i].sample_ms || expect[i].count != got[i].count ) {
+            printf("sample %d: devid %s/%s time %lld/%lld count %d/%d\n", i, expect[i].devid, got[i].devid,
+                        (long long)expect[i].sample_ms, (long long)got[i].sample_ms, expect[i].count, got[i].count);
+            return -1;
+        }
+        for( j = 0; j < expect[i].count; j++ ) {
+            if( strcmp(expect[i].reading[j].serial, got[i].reading[j].serial) || expect[i].reading[j].mtemper != got[i].reading[j].mtemper ) {
+                printf("sample %d reading %d: %s/%s %d/%d\n", i, j, expect[i].reading[j].serial, got[i].reading[j].serial,
+                            expect[i].reading[j].mtemper, got[i].reading[j].mtemper);
+                return -2;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/*	description:	decode a damaged copy in a buffer of it's exact size, so a read past
+ *                  it is caught by sanitizer, whatever is decoded must be within bounds
+ *	 input args:
+ *					$codec     : codec under test
+ *					$pack_buf  : damaged packet
+ *					$bytes     : damaged packet bytes
+ *					$pack_info : samples output
+ *					$count     : decoded samples output, <0 means rejected
+ * return value:    <0: out of bounds   0: rejected or decoded within bounds
+ */
+static int fuzzDamaged(fuzz_codec_t *codec, const char *pack_buf, int bytes, pack_info_t *pack_info, int *count) {
+
+    char            *copy = malloc(bytes ? bytes : 1);
+    int             i;
+
+    memcpy(copy, pack_buf, bytes);
+    *count = codec->decode(copy, bytes, pack_info, PACK_TS_MAX_SAMPLES);
+    free(copy);
+
+    for( i = 0; i < *count; i++ ) {
+        if( pack_info[i].count < 0 || pack_info[i].count > PACK_MAX_SENSORS || strlen(pack_info[i].devid) >= DEVID_LEN ) {
+            return -1;
+        }
+    }
+
+    return *count > PACK_TS_MAX_SAMPLES ? -2 : 0;
+}
+
+
+/*	description:	varint and zigzag varint round trip on random 64 bits values
+ * return value:    <0: failure   0: success
+ */
+static int fuzzVarint(void) {
+
+    unsigned char   buf[32];
+    tscodec_buf_t   tb;
+    uint64_t        u = fuzzRand() >> fuzzRange(0, 63);
+    int64_t         s = (int64_t)(fuzzRand() >> fuzzRange(0, 63)) * (fuzzRand() % 2 ? 1 : -1);
+    uint64_t        u_got = 0;
+    int64_t         s_got = 0;
+    int             bytes;
+
+    tscodecInit(&tb, buf, sizeof(buf));
+    tscodecPutVarint(&tb, u);
+    tscodecPutSvarint(&tb, s);
+    if( (bytes = tscodecEnd(&tb)) < 0 ) {
+        return -1;
+    }
+
+    tscodecInit(&tb, buf, bytes);
+    if( tscodecGetVarint(&tb, &u_got) < 0 || tscodecGetSvarint(&tb, &s_got) < 0 || u_got != u || s_got != s || tb.len != bytes ) {
+        printf("varint %llu/%llu svarint %lld/%lld\n", (unsigned long long)u, (unsigned long long)u_got, (long long)s, (long long)s_got);
+        return -2;
+    }
+
+    // every truncation is rejected
+    tscodecInit(&tb, buf, bytes - 1);
+    if( !tscodecGetVarint(&tb, &u_got) && !tscodecGetSvarint(&tb, &s_got) ) {
+        printf("truncated varints decoded\n");
+        return -3;
+    }
+
+    return 0;
+}
+
+
+/*	description:	round trip a random batch through one codec, then check smaller buffers,
+ *                  truncated and bit flipped packets
+ *	 input args:
+ *					$codec  : codec under test
+ *					$expect : random samples
+ *					$count  : samples count
+ * return value:    <0: failure   0: success
+ */
+static int fuzzCodec(fuzz_codec_t *codec, pack_info_t *expect, int count) {
+
+    static pack_info_t  got[PACK_TS_MAX_SAMPLES];
+    static char         pack_buf[PACK_BUF_LEN];
+    static char         got_buf[PACK_BUF_LEN];
+    int                 bytes;
+    int                 step;
+    int                 rv;
+    int                 len;
+    int                 j;
+
+    if( (bytes = codec->pack(expect, count, pack_buf, sizeof(pack_buf))) <= 0 ) {
+        printf("packet %d samples failure, errcode = %d\n", count, bytes);
+        return -1;
+    }
+    if( (rv = codec->decode(pack_buf, bytes, got, PACK_TS_MAX_SAMPLES)) != count || fuzzCompare(expect, got, count) < 0 ) {
+        printf("round trip of %d samples %d bytes, decoded %d\n", count, bytes, rv);
+        return -2;
+    }
+
+    // every buffer smaller than packet is refused, never filled with a cut packet
+    step = 1 + bytes / FUZZ_LENGTHS;
+    for( len = (int)fuzzRange(1, step); len < bytes; len += step ) {
+        if( (rv = codec->pack(expect, count, got_buf, len)) >= 0 ) {
+            printf("%d samples packeted in %d of %d bytes\n", count, rv, bytes);
+            return -3;
+        }
+    }
+
+    // every truncation misses some item, it can't decode
+    for( len = (int)fuzzRange(0, step - 1); len < bytes; len += step ) {
+        if( fuzzDamaged(codec, pack_buf, len, got, &rv) < 0 || rv >= 0 ) {
+            printf("truncated to %d of %d bytes decoded %d samples\n", len, bytes, rv);
+            return -4;
+        }
+    }
+
+    // bit flips may still decode, but never out of bounds
+    for( j = 0; j < FUZZ_FLIPS; j++ ) {
+        pack_buf[fuzzRand() % bytes] ^= 1 << (fuzzRand() % 8);
+        if( fuzzDamaged(codec, pack_buf, bytes, got, &rv) < 0 ) {
+            printf("bit flipped packet decoded out of bounds\n");
+            return -5;
+        }
+        codec->damaged++;
+        codec->accepted += rv >= 0;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+
+    static pack_info_t  expect[PACK_TS_MAX_SAMPLES];
+    char                *progname = NULL;
+    uint64_t            seed = (uint64_t)time(NULL);
+    long                loops = 500;
+    int                 count;
+    int                 rv;
+    long                i;
+    int                 j;
+
+    struct option       opts[] = {
+                            {"loops", required_argument, NULL, 'n'},
+                            {"seed", required_argument, NULL, 's'},
+                            {"help", no_argument, NULL, 'h'},
+                            {NULL, 0, NULL, 0}
+                        };
+
+    progname = (char *)basename(argv[0]);
+    while( (rv = getopt_long(argc, argv, "n:s:h", opts, NULL)) != -1 ) {
+        switch(rv) {
+
+            case 'n':
+                loops = atol(optarg);
+                break;
+
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'h':
+                printUsage(progname);
+                return 0;
+
+            default:
+                break;
+        }
+    }
+
+    if( loops <= 0 ) {
+        printUsage(progname);
+        return -1;
+    }
+
+    printf("seed %llu, %ld batches\n", (unsigned long long)seed, loops);
+    fuzz_state = seed ? seed : 1;
+
+    for( i = 0; i < loops; i++ ) {
+        if( fuzzVarint() < 0 ) {
+            printf("FAIL varint round trip at loop %ld\n", i);
+            return 1;
+        }
+
+        count = fuzzBatch(expect);
+        for( j = 0; j < (int)(sizeof(fuzz_codec) / sizeof(fuzz_codec[0])); j++ ) {
+            if( fuzzCodec(&fuzz_codec[j], expect, count) < 0 ) {
+                printf("FAIL %s codec at loop %ld\n", fuzz_codec[j].name, i);
+                return 1;
+            }
+        }
+    }
+
+    for( j = 0; j < (int)(sizeof(fuzz_codec) / sizeof(fuzz_codec[0])); j++ ) {
+        printf("ok   %-11s %ld round trips, %ld bit flipped packets, %ld of them still decoded\n",
+                    fuzz_codec[j].name, loops, fuzz_codec[j].damaged, fuzz_codec[j].accepted);
+    }
+
+    return 0;
+}
@@ -0,0 +1,410 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  w1sim.c
+ *    Description:  This file is a simulated w1 bus tool, it builds a fake
+ *                  /sys/bus/w1/devices tree with N virtual ds18b20 probes and
+ *                  keeps their w1_slave files updated, so client can run and
+ *                  be load tested without hardware.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 00时50分55秒"
+ *
+ * Usage:
+ *
+ *          ./w1sim -d /tmp/w1 -n 1000 -c sine -e 1 -l 750
+ *
+ *          then set "w1path=/tmp/w1" in client.conf
+ *
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <sys/stat.h>
+
+#define BULK_READ_DIR       "w1_bus_master1"
+#define MAX_SCRIPT_POINTS   256
+
+typedef struct probe_s
+{
+    char            serial[24];         // 28-xxxxxxxxxxxx
+    int             fd;                 // w1_slave file descriptor
+} probe_t;
+
+typedef struct script_point_s
+{
+    long            ms;                 // time offset from script start
+    int             mtemper;            // temperature in milli-degrees
+} script_point_t;
+
+static struct {
+    char            dir[128];           // fake w1 bus devices directory
+    int             count;              // probes count
+    char            curve[16];          // const, ramp, sine or script
+    int             crc_error;          // percent of reads with bad crc
+    int             latency;            // bulk conversion latency in ms
+    int             interval;           // update interval in ms
+    int             npoints;            // script points
+    script_point_t  point[MAX_SCRIPT_POINTS];
+    probe_t         *probe;
+    int             bulk_fd;            // therm_bulk_read file descriptor
+} sim;
+
+static volatile int g_stop = 0;
+
+
+// print help information
+static void printUsage(char *progname) {
+
+    printf("Usage: %s [OPTION]...\n", progname);
+    printf(" %s builds a fake w1 bus devices tree with virtual ds18b20 probes\n", progname);
+    printf("\nMandatory arguments to long options are mandatory for short options too:\n");
+    printf("-d(--dir)      : fake w1 bus devices directory\n");
+    printf("-n(--probes)   : virtual probes count, default 8\n");
+    printf("-c(--curve)    : temperature curve const/ramp/sine, default sine\n");
+    printf("-s(--script)   : temperature script file, each line \"<ms> <milli-degrees>\"\n");
+    printf("-e(--crcerr)   : percent of reads with bad crc, default 0\n");
+    printf("-l(--latency)  : bulk conversion latency in ms, default 750\n");
+    printf("-i(--interval) : w1_slave update interval in ms, default 100\n");
+    printf("-h(--help)     : display this help information\n");
+    return;
+}
+
+
+static void sigHandler(int sig) {
+
+    g_stop = 1;
+}
+
+
+/*	description:	get current time in milliseconds from monotonic clock */
+static long nowMs(void) {
+
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/*	description:	dallas/maxim crc8, the one ds18b20 uses on scratchpad */
+static uint8_t crc8(const uint8_t *data, int len) {
+
+    uint8_t         crc = 0;
+    uint8_t         byte;
+    int             i, j;
+
+    for( i = 0; i < len; i++ ) {
+        byte = data[i];
+        for( j = 0; j < 8; j++ ) {
+            crc = ((crc ^ byte) & 0x01) ? (crc >> 1) ^ 0x8C : crc >> 1;
+            byte >>= 1;
+        }
+    }
+
+    return crc;
+}
+
+
+/*	description:	load temperature script, it's looped when time passed the last point
+ *	 input args:
+ *					$file : script file path
+ * return value:    <0: failure   0: success
+ */
+static int loadScript(const char *file) {
+
+    FILE            *fp = NULL;
+    char            line[128];
+
+    if( !(fp = fopen(file, "r")) ) {
+        fprintf(stderr, "open script %s failure: %s\n", file, strerror(errno));
+        return -1;
+    }
+
+    while( fgets(line, sizeof(line), fp) && sim.npoints < MAX_SCRIPT_POINTS ) {
+        if( line[0] == '#' ) {
+            continue;
+        }
+        if( sscanf(line, "%ld %d", &sim.point[sim.npoints].ms, &sim.point[sim.npoints].mtemper) == 2 ) {
+            sim.npoints++;
+        }
+    }
+    fclose(fp);
+
+    return sim.npoints ? 0 : -2;
+}
+
+
+/*	description:	get temperature of probe at time $ms
+ *	 input args:
+ *					$index : probe index, each probe gets a different phase
+ *					$ms    : time in ms since simulation start
+ * return value:    temperature in milli-degrees
+ */
+static int probeTemper(int index, long ms) {
+
+    long            t;
+    int             i;
+
+    if( sim.npoints ) {
+        t = (ms + index * 1000L) % (sim.point[sim.npoints - 1].ms + 1);
+        for( i = 1; i < sim.npoints; i++ ) {
+            if( t <= sim.point[i].ms ) {
+                return sim.point[i - 1].mtemper + (int)((long long)(sim.point[i].mtemper - sim.point[i - 1].mtemper) *
+                        (t - sim.point[i - 1].ms) / (sim.point[i].ms - sim.point[i - 1].ms + 1));
+            }
+        }
+        return sim.point[sim.npoints - 1].mtemper;
+    }
+
+    if( !strcmp(sim.curve, "const") ) {
+        return 25000 + index * 10;
+    }
+    else if( !strcmp(sim.curve, "ramp") ) {
+        // 10 -> 40 degrees in 10 minutes
+        return 10000 + (int)((ms / 20 + index * 100L) % 30000);
+    }
+
+    // 25 +- 10 degrees, one period in 5 minutes
+    return 25000 + (int)(10000 * sin(2 * M_PI * (ms + index * 997L) / 300000.0));
+}
+
+
+/*	description:	write w1_slave file content just like w1_therm driver does
+ *	 input args:
+ *					$probe   : virtual probe
+ *					$mtemper : temperature in milli-degrees
+ */
+static void probeWrite(probe_t *probe, int mtemper) {
+
+    char            buf[128];
+    uint8_t         pad[9] = {0, 0, 0x4b, 0x46, 0x7f, 0xff, 0x0c, 0x10, 0};
+    int16_t         raw = (int16_t)(mtemper * 16 / 1000);
+    int             bad = sim.crc_error && (rand() % 100) < sim.crc_error;
+    int             len;
+
+    pad[0] = raw & 0xff;
+    pad[1] = (raw >> 8) & 0xff;
+    pad[8] = crc8(pad, 8);
+    if( bad ) {
+        pad[8] ^= 0x5a;
+    }
+
+    len = snprintf(buf, sizeof(buf),
+            "%02x %02x %02x %02x %02x %02x %02x %02x %02x : crc=%02x %s\n"
+            "%02x %02x %02x %02x %02x %02x %02x %02x %02x t=%d\n",
+            pad[0], pad[1], pad[2], pad[3], pad[4], pad[5], pad[6], pad[7], pad[8], pad[8], bad ? "NO" : "YES",
+            pad[0], pad[1], pad[2], pad[3], pad[4], pad[5], pad[6], pad[7], pad[8], raw * 1000 / 16);
+
+    // rewrite in place, client keeps this file open
+    if( pwrite(probe->fd, buf, len, 0) == len ) {
+        ftruncate(probe->fd, len);
+    }
+
+    return;
+}
+
+
+/*	description:	write a small attribute file
+ *	 input args:
+ *					$path  : file path
+ *					$value : file content
+ * return value:    <0: failure   >=0: file descriptor if $keep, or 0
+ */
+static int writeAttr(const char *path, const char *value, int keep) {
+
+    int             fd = -1;
+
+    if( (fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0 ) {
+        fprintf(stderr, "create %s failure: %s\n", path, strerror(errno));
+        return -1;
+    }
+    write(fd, value, strlen(value));
+
+    if( keep ) {
+        return fd;
+    }
+    close(fd);
+
+    return 0;
+}
+
+
+/*	description:	build fake w1 bus tree: bus master with therm_bulk_read, and
+ *                  28-xxxxxxxxxxxx/{w1_slave,resolution} for every probe
+ * return value:    <0: failure   0: success
+ */
+static int buildTree(void) {
+
+    char            path[256];
+    int             i;
+
+    mkdir(sim.dir, 0755);
+
+    snprintf(path, sizeof(path), "%s/%s", sim.dir, BULK_READ_DIR);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/%s/therm_bulk_read", sim.dir, BULK_READ_DIR);
+    if( (sim.bulk_fd = writeAttr(path, "0\n", 1)) < 0 ) {
+        return -1;
+    }
+
+    if( !(sim.probe = calloc(sim.count, sizeof(probe_t))) ) {
+        return -2;
+    }
+
+    for( i = 0; i < sim.count; i++ ) {
+        snprintf(sim.probe[i].serial, sizeof(sim.probe[i].serial), "28-%012x", 0x5f0000 + i);
+
+        snprintf(path, sizeof(path), "%s/%s", sim.dir, sim.probe[i].serial);
+        if( mkdir(path, 0755) < 0 && errno != EEXIST ) {
+            fprintf(stderr, "create %s failure: %s\n", path, strerror(errno));
+            return -3;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s/resolution", sim.dir, sim.probe[i].serial);
+        writeAttr(path, "12\n", 0);
+
+        snprintf(path, sizeof(path), "%s/%s/w1_slave", sim.dir, sim.probe[i].serial);
+        if( (sim.probe[i].fd = writeAttr(path, "", 1)) < 0 ) {
+            return -4;
+        }
+        probeWrite(&sim.probe[i], probeTemper(i, 0));
+    }
+
+    printf("w1sim: %d probes in %s\n", sim.count, sim.dir);
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+
+    char            *progname = NULL;
+    char            buf[16];
+    long            start = nowMs();
+    long            convert = 0;        // bulk conversion finish time, 0 means idle
+    long            now;
+    int             rv;
+    int             i;
+
+    struct option   opts[] = {
+                        {"dir", required_argument, NULL, 'd'},
+                        {"probes", required_argument, NULL, 'n'},
+                        {"curve", required_argument, NULL, 'c'},
+                        {"script", required_argument, NULL, 's'},
+                        {"crcerr", required_argument, NULL, 'e'},
+                        {"latency", required_argument, NULL, 'l'},
+                        {"interval", required_argument, NULL, 'i'},
+                        {"help", no_argument, NULL, 'h'},
+                        {NULL, 0, NULL, 0}
+                    };
+
+    sim.count = 8;
+    sim.latency = 750;
+    sim.interval = 100;
+    strcpy(sim.curve, "sine");
+
+    progname = (char *)basename(argv[0]);
+    while( (rv = getopt_long(argc, argv, "d:n:c:s:e:l:i:h", opts, NULL)) != -1 ) {
+        switch(rv) {
+
+            case 'd':
+                strncpy(sim.dir, optarg, sizeof(sim.dir) - 1);
+                break;
+
+            case 'n':
+                sim.count = atoi(optarg);
+                break;
+
+            case 'c':
+                strncpy(sim.curve, optarg, sizeof(sim.curve) - 1);
+                break;
+
+            case 's':
+                if( loadScript(optarg) < 0 ) {
+                    return -1;
+                }
+                break;
+
+            case 'e':
+                sim.crc_error = atoi(optarg);
+                break;
+
+            case 'l':
+                sim.latency = atoi(optarg);
+                break;
+
+            case 'i':
+                sim.interval = atoi(optarg);
+                break;
+
+            case 'h':
+                printUsage(progname);
+                return 0;
+
+            default:
+                break;
+        }
+    }
+
+    if( !strlen(sim.dir) || sim.count <= 0 || sim.interval <= 0 ) {
+        printUsage(progname);
+        return -1;
+    }
+
+    signal(SIGINT, sigHandler);
+    signal(SIGTERM, sigHandler);
+    srand(time(NULL));
+
+    if( buildTree() < 0 ) {
+        return -2;
+    }
+
+    while( !g_stop ) {
+        now = nowMs();
+
+        // client wrote "trigger": report "-1" while converting, "1" after latency passed
+        memset(buf, 0, sizeof(buf));
+        if( !convert && pread(sim.bulk_fd, buf, sizeof(buf) - 1, 0) > 0 && buf[0] == 't' ) {
+            pwrite(sim.bulk_fd, "-1\n", 3, 0);
+            ftruncate(sim.bulk_fd, 3);
+            convert = now + sim.latency;
+        }
+        if( convert && now >= convert ) {
+            for( i = 0; i < sim.count; i++ ) {
+                probeWrite(&sim.probe[i], probeTemper(i, now - start));
+            }
+            pwrite(sim.bulk_fd, "1\n", 2, 0);
+            ftruncate(sim.bulk_fd, 2);
+            convert = 0;
+        }
+
+        // keep values moving for clients reading without bulk trigger
+        if( !convert ) {
+            for( i = 0; i < sim.count; i++ ) {
+                probeWrite(&sim.probe[i], probeTemper(i, now - start));
+            }
+        }
+
+        usleep((convert && convert - now < sim.interval ? convert - now : sim.interval) * 1000);
+    }
+
+    for( i = 0; i < sim.count; i++ ) {
+        close(sim.probe[i].fd);
+    }
+    close(sim.bulk_fd);
+    free(sim.probe);
+
+    return 0;
+}
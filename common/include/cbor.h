@@ -0,0 +1,136 @@
+/********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  cbor.h
+ *    Description:  This file is a CBOR(RFC 8949) encode and decode function declare file.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时04分21秒"
+ *                 
+ ********************************************************************************/
+
+#ifndef  _CBOR_H_
+#define  _CBOR_H_
+
+#include <stdint.h>
+
+// CBOR major types
+enum {
+    CBOR_UINT,
+    CBOR_NEGINT,
+    CBOR_BYTES,
+    CBOR_TEXT,
+    CBOR_ARRAY,
+    CBOR_MAP,
+    CBOR_TAG,
+    CBOR_SIMPLE,
+};
+
+// CBOR buffer, len is bytes written when encoding, bytes read when decoding
+typedef struct cbor_buf_s {
+    unsigned char       *buf;               // data buffer
+    int                 size;               // buffer size
+    int                 len;                // bytes written or read, keeps counting when buffer is full
+} cbor_buf_t;
+
+
+/*	description:	init CBOR buffer for encoding or decoding
+ *	 input args:	
+ *					$cb   : CBOR buffer
+ *					$buf  : data buffer
+ *					$size : buffer size when encoding, data bytes when decoding
+ */
+extern void cborInit(cbor_buf_t *cb, void *buf, int size);
+
+
+/*	description:	encode unsigned integer
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$value : integer
+ */
+extern void cborPutUint(cbor_buf_t *cb, uint64_t value);
+
+
+/*	description:	encode signed integer
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$value : integer
+ */
+extern void cborPutInt(cbor_buf_t *cb, int64_t value);
+
+
+/*	description:	encode byte string
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$data  : bytes
+ *					$bytes : bytes count
+ */
+extern void cborPutBytes(cbor_buf_t *cb, const void *data, int bytes);
+
+
+/*	description:	encode UTF-8 text string
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$text  : text, no need NUL terminated
+ *					$bytes : text bytes
+ */
+extern void cborPutText(cbor_buf_t *cb, const char *text, int bytes);
+
+
+/*	description:	encode array head, $count items follow it
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$count : array items count
+ */
+extern void cborPutArray(cbor_buf_t *cb, int count);
+
+
+/*	description:	finish encoding
+ *	 input args:	
+ *					$cb : CBOR buffer
+ * return value:    <0: buffer is too small   >=0: encoded bytes
+ */
+extern int cborEnd(cbor_buf_t *cb);
+
+
+/*	description:	decode head of next item, string payload is not consumed
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$major : major type output
+ *					$value : integer value, string bytes or array count output
+ * return value:    <0: truncated or unsupported data   0: success
+ */
+extern int cborGetHead(cbor_buf_t *cb, int *major, uint64_t *value);
+
+
+/*	description:	decode signed integer
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$value : integer output
+ * return value:    <0: not an integer or out of range   0: success
+ */
+extern int cborGetInt(cbor_buf_t *cb, int64_t *value);
+
+
+/*	description:	decode array head
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$count : array items count output
+ * return value:    <0: not an array   0: success
+ */
+extern int cborGetArray(cbor_buf_t *cb, int *count);
+
+
+/*	description:	decode byte or text string, data points into CBOR buffer
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$major : CBOR_BYTES or CBOR_TEXT output
+ *					$data  : string data output
+ *					$bytes : string bytes output
+ * return value:    <0: not a string or truncated   0: success
+ */
+extern int cborGetString(cbor_buf_t *cb, int *major, const unsigned char **data, int *bytes);
+
+#endif
@@ -0,0 +1,56 @@
+/********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  clock.h
+ *    Description:  This file is a clock and time format function declare file.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时07分54秒"
+ *                 
+ ********************************************************************************/
+
+#ifndef  _CLOCK_H_
+#define  _CLOCK_H_
+
+#include <stdint.h>
+
+// "2024-04-17T12:00:00.123Z" with NUL
+#define CLOCK_STR_LEN           32
+
+
+/*	description:	get wall clock time
+ * return value:    epoch milliseconds
+ */
+extern int64_t clockNowMs(void);
+
+
+/*	description:	get monotonic clock time, for intervals and deadlines
+ * return value:    milliseconds
+ */
+extern int64_t clockMonoMs(void);
+
+
+/*	description:	format time as local "YYYY-mm-dd HH:MM:SS", seconds part is formatted
+ *                  once per second per thread, thread safe
+ *	 input args:	
+ *					$epoch_ms : epoch milliseconds
+ *					$buf      : output buffer
+ *					$size     : buffer size
+ * return value:    <0: failure   >=0: formatted bytes
+ */
+extern int clockLocalStr(int64_t epoch_ms, char *buf, int size);
+
+
+/*	description:	format time as ISO-8601 basic UTC "YYYYmmddTHHMMSSZ", the form Huawei
+ *                  event_time takes, formatted once per second per thread, thread safe
+ *	 input args:	
+ *					$epoch_ms : epoch milliseconds
+ *					$buf      : output buffer
+ *					$size     : buffer size
+ * return value:    <0: failure   >=0: formatted bytes
+ */
+extern int clockIsoUtc(int64_t epoch_ms, char *buf, int size);
+
+#endif
@@ -14,24 +14,166 @@
 #ifndef  _DATABASE_H_
 #define  _DATABASE_H_
 
+#include <stdint.h>
 #include "sqlite3.h"
 
 #define DATABASE_VERSION       "v1.0"
 #define SQL_COMMAND_LEN        256
 
+// storage backend of packets written out of memory ring
+enum {
+    DATABASE_BACKEND_SQLITE,                // sqlite database file
+    DATABASE_BACKEND_SEGMENT,               // mmap append only segment files
+};
+
+// synchronous level of database writes
+enum {
+    DATABASE_SYNC_DEFAULT,                  // DATABASE_SYNC_NORMAL
+    DATABASE_SYNC_OFF,                      // no fsync, committed packets may be lost on power failure
+    DATABASE_SYNC_NORMAL,                   // fsync at WAL checkpoint, database never corrupts
+    DATABASE_SYNC_FULL,                     // fsync at every commit
+};
+
+// group commit defaults: packets pushed are committed together when either limit is reached
+#define DATABASE_COMMIT_ROWS   32
+#define DATABASE_COMMIT_MS     1000
+
+// memory ring defaults: pushed packets are kept in memory, and written to database file when
+// they are more than bytes limit or older than time limit, so short outage never writes flash
+#define DATABASE_RING_SLOTS    256
+#define DATABASE_RING_BYTES    65536
+#define DATABASE_RING_MS       60000
+
+// most packets popped or deleted in one transaction
+#define DATABASE_BATCH_MAX     64
+
+// retention: when stored packets pass a cap, older ones are thinned to fewer packets per time
+#define DATABASE_THIN_MAX      4            // most thinning tiers
+#define DATABASE_THIN_LOW      90           // thinning goes on until packets are under this percent of caps
+#define DATABASE_EXPIRE_MS     60000        // packets older than max age are removed at this interval
+#define DATABASE_THIN_BYTES    65536        // most packet bytes thinned by packet_thin, larger ones are thinned as whole
+
+// segment backend: fixed size segment files "<fname>.<seq>.seg" and read cursor file "<fname>.cursor"
+#define DATABASE_SEGMENT_BYTES (1 << 20)
+#define DATABASE_SEGMENT_MAX   1024
+
+// free pages left by deleted packets are reclaimed by incremental vacuum, never by full VACUUM
+#define VACUUM_FREE_PAGES      256          // reclaim pages while busy when more pages are free
+#define VACUUM_STEP_PAGES      64           // pages reclaimed in one busy step, idle step reclaims all
+
+// blob packet popped in batch
+typedef struct database_pack_s {
+    int64_t             id;                 // blob packet record id
+    void                *data;              // blob packet data in caller buffer
+    int                 bytes;              // blob packet data bytes
+}database_pack_t;
+
+
+// packet record information without data
+typedef struct database_meta_s {
+    int64_t             id;                 // blob packet record id
+    int64_t             time;               // epoch milliseconds of packet, 0 means unknown
+    int                 bytes;              // blob packet data bytes
+}database_meta_t;
+
+// thinning tier: packets older than age keep one packet per interval, or one sample per interval with packet_thin
+typedef struct database_thin_s {
+    int                 age;                // seconds
+    int                 interval;           // seconds
+}database_thin_t;
+
+
+// database options, 0 means default
+typedef struct database_opt_s {
+    int                 backend;            // DATABASE_BACKEND_*
+    int                 sync;               // DATABASE_SYNC_*
+    int                 commit_rows;        // pushed packets committed together, 1 means commit every one
+    int                 commit_ms;          // most milliseconds a pushed packet waits for commit
+    int                 ring_bytes;         // most packets bytes kept in memory
+    int                 ring_ms;            // most milliseconds a packet is kept in memory
+    int64_t             max_rows;           // most stored packets, 0 means no limit
+    int64_t             max_bytes;          // most stored packets bytes, 0 means no limit
+    int                 max_age;            // most seconds a packet is stored, 0 means no limit
+    int                 nthin;              // thinning tiers, 0 means 1 per minute after 1 hour, 1 per 10 minutes after 1 day
+    database_thin_t     thin[DATABASE_THIN_MAX]; // thinning tiers in ascending age
+    // time packet is stored with, NULL or <=0 returned means push time
+    int64_t             (*packet_time)(const void *pack, int bytes);
+    // thin samples in packet as packetTsThin() does, NULL or <0 returned means packet is thinned as whole
+    int                 (*packet_thin)(const void *pack, int bytes, int64_t before, int64_t interval, int64_t *bucket, void *buf, int size);
+}database_opt_t;
+
+
+/* storage backend, memory ring writes packets into it with ascending record ids and pops them in
+ * record id order, functions return <0 on failure as database API does
+ */
+typedef struct database_backend_s {
+    const char          *name;
+    // open storage with options defaults filled, get record id following the last stored one and
+    // stored packets count and bytes, they are counted by caller from now on
+    int                 (*open)(char *fname, database_opt_t *opt, int64_t *next_id, int64_t *rows, int64_t *bytes);
+    void                (*close)(void);
+    // store a packet with it's time in group commit
+    int                 (*insert)(int64_t id, int64_t time, void *pack, int size);
+    // pop packets after a record, $more is set when there are packets left after popped ones
+    int                 (*pop)(int64_t after, database_pack_t *packs, int count, void *buf, int size, int *more);
+    // get information of packets after a record, return packets count
+    int                 (*scan)(int64_t after, database_meta_t *metas, int count);
+    // remove packets, return packets removed and set $bytes of them, ids not stored are skipped
+    int                 (*del)(int64_t *ids, int count, int64_t *bytes);
+    // replace data of a packet by smaller one in group commit, record id and time are kept, $bytes
+    // is set to bytes freed
+    int                 (*update)(int64_t id, void *pack, int size, int64_t *bytes);
+    // commit stored packets, $force 0 means only when row or time limit is reached
+    int                 (*commit)(int force);
+    // milliseconds until stored packets must be committed, -1 means nothing to commit
+    int                 (*timeout)(void);
+    // reclaim space of removed packets, return pages or segment files reclaimed
+    int                 (*vacuum)(int idle);
+}database_backend_t;
+
+extern database_backend_t   dbsqlite_backend;
+extern database_backend_t   dbsegment_backend;
+
+
 /*	description:	init database system
  *	 input args:	
  *					$fname: database file name
+ *					$opt  : database options, NULL means default
  * return value:    <0: failure   0: success
  */
-extern int databaseInit(char *fname);
+extern int databaseInit(char *fname, database_opt_t *opt);
 
 
-/* description: terminate sqlite database */
+/* description: spill packets in memory to database file, commit them and terminate sqlite database */
 extern void databaseTerm(void);
 
 
-/* description :    push a blob packet into database
+/* description :    commit pushed packets of group commit
+ *  input args :
+ *      $force :    1: commit now   0: commit only if row or time limit is reached
+ * return value:    <0: failure   0: success
+ */
+extern int databaseCommit(int force);
+
+
+/* description :    spill packets in memory ring which reach age limit to database file, and
+ *                  commit pushed packets which reach row or time limit, call it periodically
+ *  input args :
+ *        $all :    1: spill all packets in memory ring, at shutdown   0: spill aged packets only
+ * return value:    <0: failure   0: success
+ */
+extern int databaseFlush(int all);
+
+
+/* description :    get time until packets in memory must be spilled or pushed packets must be
+ *                  committed, so the event loop can sleep on it
+ * return value:    -1: no packet waits   >=0: milliseconds
+ */
+extern int databaseTimeout(void);
+
+
+/* description :    push a blob packet, it's kept in memory ring and written to database file
+ *                  when memory ring is full, it's too old, or at databaseTerm()
  *  input args :
  *       $pack :    blob packet data address
  *       $size :    blob packet data bytes
@@ -40,20 +182,58 @@ extern void databaseTerm(void);
 extern int databasePushPacket(void *pack, int size);
 
 
-/* description :    pop first blob packet from database
+/* description :    pop first blob packet after a record from database, packet stays in
+ *                  database until it's removed by databaseDelPacket()
  *  input args :
+ *      $after :    record id of last popped packet, 0 means pop from first packet
  *       $pack :    blob packet output buffer address
  *       $size :    blob packet output buffer size
  *       $byte :    blob packet data bytes
+ *         $id :    blob packet record id
  * return value:    <0: failure   0: success
  */
-extern int databasePopPacket(void *pack, int size, int *bytes);
+extern int databasePopPacket(int64_t after, void *pack, int size, int *bytes, int64_t *id);
 
 
-/* description :    remove first blob packet from database
+/* description :    pop blob packets after a record from database in one query, packets stay
+ *                  in database until they're removed by databaseDelPackets()
+ *  input args :
+ *      $after :    record id of last popped packet, 0 means pop from first packet
+ *      $packs :    popped packets output, data points into $buf
+ *      $count :    most packets popped, at most DATABASE_BATCH_MAX
+ *        $buf :    blob packets data output buffer, packets which don't fit are left for next pop
+ *       $size :    blob packets data output buffer size
+ * return value:    <0: failure   0: no packet   >0: packets popped
+ */
+extern int databasePopPackets(int64_t after, database_pack_t *packs, int count, void *buf, int size);
+
+
+/* description :    remove a blob packet from database
+ *  input args :
+ *         $id :    blob packet record id
  * return value:    <0: failure   0: success
  */
-extern int databaseDelPacket(void);
+extern int databaseDelPacket(int64_t id);
+
+
+/* description :    remove blob packets from database in one transaction
+ *  input args :
+ *        $ids :    blob packet record ids
+ *      $count :    record ids count
+ * return value:    <0: failure   0: success
+ */
+extern int databaseDelPackets(int64_t *ids, int count);
+
+
+/* description :    reclaim space of removed packets, incremental vacuum of database file or
+ *                  compaction of segment files, call it periodically, it does nothing when
+ *                  there is little to reclaim
+ *  input args :
+ *       $idle :    1: no backlog is draining, reclaim all free pages
+ *                  0: backlog is draining, reclaim a step only if free pages pass threshold
+ * return value:    <0: failure   >=0: pages or segment files reclaimed
+ */
+extern int databaseVacuum(int idle);
 
 
 #endif
@@ -29,10 +29,25 @@ typedef struct proc_signal
 typedef void* (*threadFunc)(void *thread_arg);
 
 
+/* description:     sighandler when process catch a signal
+ * input args :  
+ *                  $sig: signal whitch being catched by process
+ */
+extern void procDefaultSighandler(int sig);
+
+
 /* description: install default signal process functions */
 extern void installDefaultSignal(void);
 
 
+/* description:     block SIGINT and SIGTERM and deliver them through a signalfd instead, so
+ *                  event loop can wait on them. Call it before any thread is started, threads
+ *                  inherit the blocked signal mask
+ * return value:    <0: failure   >=0: signalfd
+ */
+extern int installSignalFd(void);
+
+
 /*	description:	check daemon process running or not
  *	 input args:	
  *					$pidfile: file path whitch record PID
@@ -0,0 +1,138 @@
+/********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  tscodec.h
+ *    Description:  This file is a time series compression function declare file.
+ *
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时06分52秒"
+ *                 
+ ********************************************************************************/
+
+#ifndef  _TSCODEC_H_
+#define  _TSCODEC_H_
+
+#include <stdint.h>
+
+// time series buffer, len is bytes written when encoding, bytes read when decoding
+typedef struct tscodec_buf_s {
+    unsigned char       *buf;               // data buffer
+    int                 size;               // buffer size
+    int                 len;                // bytes written or read, keeps counting when buffer is full
+} tscodec_buf_t;
+
+
+/*	description:	init time series buffer for encoding or decoding
+ *	 input args:	
+ *					$tb   : time series buffer
+ *					$buf  : data buffer
+ *					$size : buffer size when encoding, data bytes when decoding
+ */
+extern void tscodecInit(tscodec_buf_t *tb, void *buf, int size);
+
+
+/*	description:	encode unsigned integer as LEB128 varint, 7 bits per byte
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$value : integer
+ */
+extern void tscodecPutVarint(tscodec_buf_t *tb, uint64_t value);
+
+
+/*	description:	encode signed integer as zigzag varint, small magnitude takes few bytes
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$value : integer
+ */
+extern void tscodecPutSvarint(tscodec_buf_t *tb, int64_t value);
+
+
+/*	description:	encode raw bytes
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$data  : bytes
+ *					$bytes : bytes count
+ */
+extern void tscodecPutRaw(tscodec_buf_t *tb, const void *data, int bytes);
+
+
+/*	description:	encode timestamps column: first timestamp, first delta, then delta of
+ *                  deltas, regular sample interval costs one byte per timestamp
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$ts    : timestamps
+ *					$count : timestamps count
+ */
+extern void tscodecPutTimes(tscodec_buf_t *tb, const int64_t *ts, int count);
+
+
+/*	description:	encode values column: presence bitmap, then zigzag delta of every present
+ *                  value from previous present one
+ *	 input args:	
+ *					$tb      : time series buffer
+ *					$values  : values, value is ignored when it's not present
+ *					$present : 1 means value present, 0 means missing
+ *					$count   : values count
+ */
+extern void tscodecPutColumn(tscodec_buf_t *tb, const int *values, const unsigned char *present, int count);
+
+
+/*	description:	finish encoding
+ *	 input args:	
+ *					$tb : time series buffer
+ * return value:    <0: buffer is too small   >=0: encoded bytes
+ */
+extern int tscodecEnd(tscodec_buf_t *tb);
+
+
+/*	description:	decode unsigned varint
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$value : integer output
+ * return value:    <0: truncated or too long   0: success
+ */
+extern int tscodecGetVarint(tscodec_buf_t *tb, uint64_t *value);
+
+
+/*	description:	decode zigzag varint
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$value : integer output
+ * return value:    <0: truncated or too long   0: success
+ */
+extern int tscodecGetSvarint(tscodec_buf_t *tb, int64_t *value);
+
+
+/*	description:	decode raw bytes, data points into time series buffer
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$data  : bytes output
+ *					$bytes : bytes count
+ * return value:    <0: truncated   0: success
+ */
+extern int tscodecGetRaw(tscodec_buf_t *tb, const unsigned char **data, int bytes);
+
+
+/*	description:	decode timestamps column
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$ts    : timestamps output
+ *					$count : timestamps count
+ * return value:    <0: truncated   0: success
+ */
+extern int tscodecGetTimes(tscodec_buf_t *tb, int64_t *ts, int count);
+
+
+/*	description:	decode values column
+ *	 input args:	
+ *					$tb      : time series buffer
+ *					$values  : values output, missing value is 0
+ *					$present : presence output
+ *					$count   : values count
+ * return value:    <0: truncated or value out of range   0: success
+ */
+extern int tscodecGetColumn(tscodec_buf_t *tb, int *values, unsigned char *present, int count);
+
+#endif
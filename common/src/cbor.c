@@ -0,0 +1,290 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  cbor.c
+ *    Description:  This file is a CBOR(RFC 8949) encode and decode function file.
+ *                  Only definite length integers, strings and arrays are supported,
+ *                  it's enough for sample payloads and keeps both ends small.
+ *                 
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时04分21秒"
+ *                 
+ ********************************************************************************/
+
+#include <string.h>
+#include "cbor.h"
+
+
+/*	description:	init CBOR buffer for encoding or decoding
+ *	 input args:	
+ *					$cb   : CBOR buffer
+ *					$buf  : data buffer
+ *					$size : buffer size when encoding, data bytes when decoding
+ */
+void cborInit(cbor_buf_t *cb, void *buf, int size) {
+
+    cb->buf = buf;
+    cb->size = size;
+    cb->len = 0;
+
+    return;
+}
+
+
+/*	description:	encode item head, value uses the shortest argument length
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$major : major type
+ *					$value : argument value
+ */
+static void cborPutHead(cbor_buf_t *cb, int major, uint64_t value) {
+
+    unsigned char       head[9];
+    int                 bytes;
+    int                 i;
+
+    if( value < 24 ) {
+        head[0] = major << 5 | value;
+        bytes = 1;
+    }
+    else {
+        // additional info 24~27 means 1, 2, 4, 8 bytes argument
+        bytes = value <= 0xff ? 1 : value <= 0xffff ? 2 : value <= 0xffffffffULL ? 4 : 8;
+        head[0] = major << 5 | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27);
+        for( i = bytes; i > 0; i-- ) {
+            head[i] = value & 0xff;
+            value >>= 8;
+        }
+        bytes++;
+    }
+
+    if( cb->len + bytes <= cb->size ) {
+        memcpy(cb->buf + cb->len, head, bytes);
+    }
+    cb->len += bytes;
+
+    return;
+}
+
+
+/*	description:	encode unsigned integer
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$value : integer
+ */
+void cborPutUint(cbor_buf_t *cb, uint64_t value) {
+
+    cborPutHead(cb, CBOR_UINT, value);
+
+    return;
+}
+
+
+/*	description:	encode signed integer
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$value : integer
+ */
+void cborPutInt(cbor_buf_t *cb, int64_t value) {
+
+    // negative integer n is encoded as -1-n
+    if( value < 0 ) {
+        cborPutHead(cb, CBOR_NEGINT, (uint64_t)(-1 - value));
+    }
+    else {
+        cborPutHead(cb, CBOR_UINT, (uint64_t)value);
+    }
+
+    return;
+}
+
+
+/*	description:	encode string with major type
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$major : CBOR_BYTES or CBOR_TEXT
+ *					$data  : string data
+ *					$bytes : string bytes
+ */
+static void cborPutString(cbor_buf_t *cb, int major, const void *data, int bytes) {
+
+    cborPutHead(cb, major, bytes);
+    if( cb->len + bytes <= cb->size ) {
+        memcpy(cb->buf + cb->len, data, bytes);
+    }
+    cb->len += bytes;
+
+    return;
+}
+
+
+/*	description:	encode byte string
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$data  : bytes
+ *					$bytes : bytes count
+ */
+void cborPutBytes(cbor_buf_t *cb, const void *data, int bytes) {
+
+    cborPutString(cb, CBOR_BYTES, data, bytes);
+
+    return;
+}
+
+
+/*	description:	encode UTF-8 text string
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$text  : text, no need NUL terminated
+ *					$bytes : text bytes
+ */
+void cborPutText(cbor_buf_t *cb, const char *text, int bytes) {
+
+    cborPutString(cb, CBOR_TEXT, text, bytes);
+
+    return;
+}
+
+
+/*	description:	encode array head, $count items follow it
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$count : array items count
+ */
+void cborPutArray(cbor_buf_t *cb, int count) {
+
+    cborPutHead(cb, CBOR_ARRAY, count);
+
+    return;
+}
+
+
+/*	description:	finish encoding
+ *	 input args:	
+ *					$cb : CBOR buffer
+ * return value:    <0: buffer is too small   >=0: encoded bytes
+ */
+int cborEnd(cbor_buf_t *cb) {
+
+    return cb->len <= cb->size ? cb->len : -1;
+}
+
+
+/*	description:	decode head of next item, string payload is not consumed
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$major : major type output
+ *					$value : integer value, string bytes or array count output
+ * return value:    <0: truncated or unsupported data   0: success
+ */
+int cborGetHead(cbor_buf_t *cb, int *major, uint64_t *value) {
+
+    int                 info;
+    int                 bytes;
+
+    if( cb->len >= cb->size ) {
+        return -1;
+    }
+
+    *major = cb->buf[cb->len] >> 5;
+    info = cb->buf[cb->len] & 0x1f;
+    cb->len++;
+
+    if( info < 24 ) {
+        *value = info;
+        return 0;
+    }
+
+    // indefinite length and reserved values are not supported
+    if( info > 27 ) {
+        return -2;
+    }
+    bytes = 1 << (info - 24);
+    if( cb->len + bytes > cb->size ) {
+        return -1;
+    }
+
+    for( *value = 0; bytes > 0; bytes-- ) {
+        *value = *value << 8 | cb->buf[cb->len++];
+    }
+
+    return 0;
+}
+
+
+/*	description:	decode signed integer
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$value : integer output
+ * return value:    <0: not an integer or out of range   0: success
+ */
+int cborGetInt(cbor_buf_t *cb, int64_t *value) {
+
+    int                 major;
+    uint64_t            arg;
+
+    if( cborGetHead(cb, &major, &arg) < 0 ) {
+        return -1;
+    }
+    if( (major != CBOR_UINT && major != CBOR_NEGINT) || arg > INT64_MAX ) {
+        return -2;
+    }
+
+    *value = major == CBOR_UINT ? (int64_t)arg : -1 - (int64_t)arg;
+
+    return 0;
+}
+
+
+/*	description:	decode array head
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$count : array items count output
+ * return value:    <0: not an array   0: success
+ */
+int cborGetArray(cbor_buf_t *cb, int *count) {
+
+    int                 major;
+    uint64_t            arg;
+
+    if( cborGetHead(cb, &major, &arg) < 0 ) {
+        return -1;
+    }
+    // every item takes at least one byte
+    if( major != CBOR_ARRAY || arg > (uint64_t)(cb->size - cb->len) ) {
+        return -2;
+    }
+
+    *count = (int)arg;
+
+    return 0;
+}
+
+
+/*	description:	decode byte or text string, data points into CBOR buffer
+ *	 input args:	
+ *					$cb    : CBOR buffer
+ *					$major : CBOR_BYTES or CBOR_TEXT output
+ *					$data  : string data output
+ *					$bytes : string bytes output
+ * return value:    <0: not a string or truncated   0: success
+ */
+int cborGetString(cbor_buf_t *cb, int *major, const unsigned char **data, int *bytes) {
+
+    uint64_t            arg;
+
+    if( cborGetHead(cb, major, &arg) < 0 ) {
+        return -1;
+    }
+    if( (*major != CBOR_BYTES && *major != CBOR_TEXT) || arg > (uint64_t)(cb->size - cb->len) ) {
+        return -2;
+    }
+
+    *data = cb->buf + cb->len;
+    *bytes = (int)arg;
+    cb->len += (int)arg;
+
+    return 0;
+}
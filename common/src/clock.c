@@ -0,0 +1,126 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  clock.c
+ *    Description:  This file is a clock and time format function file. Formatted
+ *                  seconds are cached per thread, so every sample and log line
+ *                  doesn't pay localtime() and strftime().
+ *                 
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时07分54秒"
+ *                 
+ ********************************************************************************/
+
+#include <string.h>
+#include <time.h>
+#include "clock.h"
+
+// formatted seconds part of one thread
+typedef struct clock_cache_s {
+    int64_t             sec;                // epoch seconds formatted in str
+    int                 len;                // str length, 0 means nothing cached
+    char                str[CLOCK_STR_LEN];
+} clock_cache_t;
+
+static __thread clock_cache_t   local_cache;
+static __thread clock_cache_t   utc_cache;
+
+
+/*	description:	get wall clock time
+ * return value:    epoch milliseconds
+ */
+int64_t clockNowMs(void) {
+
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/*	description:	get monotonic clock time, for intervals and deadlines
+ * return value:    milliseconds
+ */
+int64_t clockMonoMs(void) {
+
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/*	description:	format seconds part into cache when second changes
+ *	 input args:	
+ *					$cache : thread's cache
+ *					$sec   : epoch seconds
+ *					$utc   : 1 means ISO-8601 UTC, 0 means local time
+ * return value:    <0: failure   0: success
+ */
+static int clockCache(clock_cache_t *cache, int64_t sec, int utc) {
+
+    time_t              t = (time_t)sec;
+    struct tm           tm;
+
+    if( cache->len && cache->sec == sec ) {
+        return 0;
+    }
+
+    if( utc ? !gmtime_r(&t, &tm) : !localtime_r(&t, &tm) ) {
+        cache->len = 0;
+        return -1;
+    }
+    cache->len = strftime(cache->str, sizeof(cache->str), utc ? "%Y%m%dT%H%M%SZ" : "%Y-%m-%d %H:%M:%S", &tm);
+    cache->sec = sec;
+
+    return cache->len ? 0 : -2;
+}
+
+
+/*	description:	format time as local "YYYY-mm-dd HH:MM:SS", seconds part is formatted
+ *                  once per second per thread, thread safe
+ *	 input args:	
+ *					$epoch_ms : epoch milliseconds
+ *					$buf      : output buffer
+ *					$size     : buffer size
+ * return value:    <0: failure   >=0: formatted bytes
+ */
+int clockLocalStr(int64_t epoch_ms, char *buf, int size) {
+
+    // round down for time before epoch
+    int64_t             sec = epoch_ms / 1000 - (epoch_ms % 1000 < 0);
+
+    if( !buf || clockCache(&local_cache, sec, 0) < 0 || size <= local_cache.len ) {
+        return -1;
+    }
+
+    memcpy(buf, local_cache.str, local_cache.len + 1);
+
+    return local_cache.len;
+}
+
+
+/*	description:	format time as ISO-8601 basic UTC "YYYYmmddTHHMMSSZ", the form Huawei
+ *                  event_time takes, formatted once per second per thread, thread safe
+ *	 input args:	
+ *					$epoch_ms : epoch milliseconds
+ *					$buf      : output buffer
+ *					$size     : buffer size
+ * return value:    <0: failure   >=0: formatted bytes
+ */
+int clockIsoUtc(int64_t epoch_ms, char *buf, int size) {
+
+    int64_t             sec = epoch_ms / 1000 - (epoch_ms % 1000 < 0);
+
+    if( !buf || clockCache(&utc_cache, sec, 1) < 0 || size <= utc_cache.len ) {
+        return -1;
+    }
+
+    memcpy(buf, utc_cache.str, utc_cache.len + 1);
+
+    return utc_cache.len;
+}
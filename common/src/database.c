@@ -3,7 +3,9 @@
  *                  All rights reserved.
  *
  *       Filename:  database.c
- *    Description:  This file is a database function file.
+ *    Description:  This file is a database function file. Packets are kept in a
+ *                  memory ring, and written to a storage backend(sqlite or mmap
+ *                  segment files) when they can't stay in memory.
  *                 
  *        Version:  1.0.0(2024年03月25日)
  *         Author:  WangMingda <wmd.de.zhanghu@gmail.com>
@@ -15,28 +17,64 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <errno.h>
 #include "database.h"
 #include "logger.h"
-
-// Blob packet table name
-#define TABLE_NAME     "PackTable"
+#include "clock.h"
 
 /* Use static global handler in order to simplify API,
  * but it will make this library not thread safe
  */
-static sqlite3         *db = NULL;
+static database_backend_t  *backend = NULL;
+static database_opt_t      options;
+
+// packet kept in memory until it's removed or spilled to storage backend
+typedef struct database_ring_s {
+    int64_t             id;                 // record id, it's kept when spilled
+    int64_t             ms;                 // time of push
+    int64_t             time;               // epoch milliseconds of packet, it's kept when spilled
+    void                *data;              // packet data, NULL means removed
+    int                 bytes;              // packet data bytes
+}database_ring_t;
+
+/* memory ring in front of storage backend, records of ring always follow records in backend, and
+ * ring records ids are consecutive from head, so a record is found by it's id directly
+ */
+static struct {
+    database_ring_t     slot[DATABASE_RING_SLOTS];
+    int                 head;               // oldest slot
+    int                 count;              // slots used from head, removed ones included
+    int                 bytes;              // packets data bytes in memory
+    int64_t             next_id;            // record id of next pushed packet
+    int64_t             spilled;            // packets written to storage backend
+    int64_t             absorbed;           // packets removed before written to storage backend
+} ring;
+
+// packets in storage backend are counted as they are written and removed, so caps are checked
+// without querying storage backend
+static struct {
+    int64_t             rows;               // packets in storage backend
+    int64_t             bytes;              // packets data bytes in storage backend
+    int64_t             expire_ms;          // time of last expiry of packets older than max age
+    int64_t             expired;            // packets removed for max age
+    int64_t             thinned;            // packets removed by thinning tiers
+    int64_t             rewritten;          // packets thinned to fewer samples by thinning tiers
+    int64_t             dropped;            // oldest packets removed when thinning is not enough
+} stored;
+
+// thinning tiers used when caps are set without tiers
+static const database_thin_t thin_defaults[] = { {3600, 60}, {86400, 600} };
 
 
 /*	description:	init database system
  *	 input args:	
- *					$fname: database file name
+ *					$fname: database file name, segment files name prefix for segment backend
+ *					$opt  : database options, NULL means default
  * return value:    <0: failure   0: success
  */
-int databaseInit(char *fname) {
+int databaseInit(char *fname, database_opt_t *opt) {
 
-    char               sql[SQL_COMMAND_LEN] = {0};
-    char               *errmsg = NULL;
+    database_thin_t     tier;
+    int                 i, k;
 
     // check input args
     if( !fname ) {
@@ -44,57 +82,486 @@ int databaseInit(char *fname) {
         return -1;
     }
 
-    // database file already exist, then open it
-    if( 0 == access(fname, F_OK) ) {
-        if( SQLITE_OK != sqlite3_open(fname, &db) ) {
-            logError("%s() failed: %s\n", __func__, sqlite3_errmsg(db));
-            return -2;
+    memset(&options, 0, sizeof(options));
+    memset(&ring, 0, sizeof(ring));
+    memset(&stored, 0, sizeof(stored));
+    if( opt ) {
+        options = *opt;
+    }
+    if( options.sync <= DATABASE_SYNC_DEFAULT || options.sync > DATABASE_SYNC_FULL ) {
+        options.sync = DATABASE_SYNC_NORMAL;
+    }
+    if( options.commit_rows <= 0 ) {
+        options.commit_rows = DATABASE_COMMIT_ROWS;
+    }
+    if( options.commit_ms <= 0 ) {
+        options.commit_ms = DATABASE_COMMIT_MS;
+    }
+    if( options.ring_bytes <= 0 ) {
+        options.ring_bytes = DATABASE_RING_BYTES;
+    }
+    if( options.ring_ms <= 0 ) {
+        options.ring_ms = DATABASE_RING_MS;
+    }
+    if( options.nthin <= 0 || options.nthin > DATABASE_THIN_MAX ) {
+        options.nthin = sizeof(thin_defaults) / sizeof(thin_defaults[0]);
+        memcpy(options.thin, thin_defaults, sizeof(thin_defaults));
+    }
+    for( i = 1; i < options.nthin; i++ ) {
+        for( k = i; k > 0 && options.thin[k - 1].age > options.thin[k].age; k-- ) {
+            tier = options.thin[k];
+            options.thin[k] = options.thin[k - 1];
+            options.thin[k - 1] = tier;
         }
-        logInfo("database system(%s) start: filename: \"%s\"\n", DATABASE_VERSION, fname);
-        return 0;
     }
+    backend = (options.backend == DATABASE_BACKEND_SEGMENT) ? &dbsegment_backend : &dbsqlite_backend;
 
-    // database not exist, then create and init it
-    if( SQLITE_OK != sqlite3_open(fname, &db) ) {
-        logError("%s() failed: %s\n", __func__, sqlite3_errmsg(db));
+    if( backend->open(fname, &options, &ring.next_id, &stored.rows, &stored.bytes) < 0 ) {
+        logError("open %s database \"%s\" failure\n", backend->name, fname);
+        backend = NULL;
         return -2;
     }
 
-    // SQLite continues without syncing as soon as it has handed data off to the operating system
-    sqlite3_exec(db, "pragma synchronous = OFF; ", NULL, NULL, NULL);
+    logInfo("database system(%s) start: %s backend \"%s\", commit every %d packets or %d ms, memory ring %d bytes or %d ms\n",
+            DATABASE_VERSION, backend->name, fname, options.commit_rows, options.commit_ms, options.ring_bytes, options.ring_ms);
+    logInfo("database stores %lld packets %lld bytes, caps %lld packets %lld bytes %d seconds\n", (long long)stored.rows,
+            (long long)stored.bytes, (long long)options.max_rows, (long long)options.max_bytes, options.max_age);
+    return 0;
+}
+
 
-    // enable full auto vacuum, Auto increase/decrease
-    sqlite3_exec(db, "pragma auto_vacuum = 2 ; ", NULL, NULL, NULL);
+/* description: spill packets in memory to storage backend, commit them and terminate database */
+void databaseTerm(void) {
 
-    // create table in the database
-    snprintf(sql, sizeof(sql), "CREATE TABLE %s(packet BLOB);", TABLE_NAME);
-    if( SQLITE_OK != sqlite3_exec(db, sql, NULL, NULL, &errmsg) ) {
-        logError("create datatable in database file '%s' failure: %s\n", fname, errmsg);
-        // free errmsg
-        sqlite3_free(errmsg);
-        // close databse 
-        sqlite3_close(db);   
-        // remove database file
-        unlink(fname);      
-        return -3;
+    if( !backend ) {
+        return ;
+    }
+
+    databaseFlush(1);
+    backend->commit(1);
+    backend->close();
+    backend = NULL;
+
+    logInfo("database memory ring spilled %lld packets to storage, %lld packets never reached storage\n",
+            (long long)ring.spilled, (long long)ring.absorbed);
+    logInfo("database retention expired %lld packets, thinned %lld packets, rewrote %lld packets, dropped %lld oldest packets\n",
+            (long long)stored.expired, (long long)stored.thinned, (long long)stored.rewritten, (long long)stored.dropped);
+    logWarn("close database success\n");
+
+    return ;
+}
+
+
+/* description :    commit pushed packets of group commit
+ *  input args :
+ *      $force :    1: commit now   0: commit only if row or time limit is reached
+ * return value:    <0: failure   0: success
+ */
+int databaseCommit(int force) {
+
+    if( !backend ) {
+        logError("database not been opened\n");
+        return -1;
+    }
+
+    return backend->commit(force);
+}
+
+
+/* description :    get time until packets in memory must be spilled or pushed packets must be
+ *                  committed, so the event loop can sleep on it
+ * return value:    -1: no packet waits   >=0: milliseconds
+ */
+int databaseTimeout(void) {
+
+    int             commit;
+    int64_t         spill;
+
+    if( !backend ) {
+        return -1;
+    }
+
+    commit = backend->timeout();
+    if( !ring.count ) {
+        return commit;
+    }
+
+    spill = ring.slot[ring.head].ms + options.ring_ms - clockMonoMs();
+    spill = spill > 0 ? spill : 0;
+
+    return (commit >= 0 && commit < spill) ? commit : (int)spill;
+}
+
+
+/* description :    remove packets from storage backend and count them out
+ *  input args :
+ *        $ids :    blob packet record ids
+ *      $count :    record ids count
+ * return value:    <0: failure   >=0: packets removed
+ */
+static int databaseStoredDel(int64_t *ids, int count) {
+
+    int64_t         bytes = 0;
+    int             n;
+
+    if( (n = backend->del(ids, count, &bytes)) < 0 ) {
+        return n;
     }
+    stored.rows -= n;
+    stored.bytes -= bytes;
+
+    return n;
+}
+
+
+/* description :    check stored packets against caps
+ *  input args :
+ *       $rows :    stored packets count
+ *      $bytes :    stored packets bytes
+ *    $percent :    percent of caps checked against
+ * return value:    0: under caps   1: over caps
+ */
+static int databaseOverCap(int64_t rows, int64_t bytes, int percent) {
+
+    return (options.max_rows > 0 && rows * 100 > options.max_rows * percent) ||
+           (options.max_bytes > 0 && bytes * 100 > options.max_bytes * percent);
+}
+
+
+/* description :    thin samples of a stored packet by packet_thin option, packet is rewritten
+ *                  with samples left
+ *  input args :
+ *         $id :    blob packet record id
+ *      $bytes :    blob packet data bytes
+ *     $before :    epoch milliseconds, samples since then are kept
+ *   $interval :    milliseconds, first sample of every interval is kept, 0 means remove all
+ *     $bucket :    interval of last sample kept
+ * return value:    <0: packet is thinned as whole   0: packet is kept   1: no sample left, packet is removed
+ */
+static int databaseThinSamples(int64_t id, int bytes, int64_t before, int64_t interval, int64_t *bucket) {
+
+    static char         data[DATABASE_THIN_BYTES];
+    static char         thin[DATABASE_THIN_BYTES];
+    database_pack_t     pack;
+    int64_t             freed = 0;
+    int                 more;
+    int                 rv;
+
+    if( !options.packet_thin || bytes > DATABASE_THIN_BYTES || backend->pop(id - 1, &pack, 1, data, sizeof(data), &more) != 1 || pack.id != id ) {
+        return -1;
+    }
+
+    if( (rv = options.packet_thin(pack.data, pack.bytes, before, interval, bucket, thin, sizeof(thin))) < 0 ) {
+        return -1;
+    }
+    if( !rv ) {
+        return 1;
+    }
+    if( rv == pack.bytes ) {
+        return 0;
+    }
+
+    // packet stays as it is when it can't be rewritten, samples are thinned again next time
+    if( backend->update(id, thin, rv, &freed) < 0 ) {
+        return 0;
+    }
+    stored.bytes -= freed;
+    stored.rewritten++;
 
-    logInfo("database system(%s) start: filename: \"%s\"\n", DATABASE_VERSION, fname);
     return 0;
 }
 
 
-/* description: terminate sqlite database */
-void databaseTerm(void) {
+/* description :    walk stored packets from oldest one and remove packets or samples older than a
+ *                  time, packets of unknown time are kept
+ *  input args :
+ *     $before :    epoch milliseconds, packets or samples since then are kept
+ *   $interval :    milliseconds, first packet or sample of every interval is kept, 0 means remove all
+ *      $total :    removed packets are counted on it
+ * return value:    <0: failure   >=0: packets removed
+ */
+static int databaseRetainWalk(int64_t before, int64_t interval, int64_t *total) {
+
+    database_meta_t     metas[DATABASE_BATCH_MAX];
+    int64_t             ids[DATABASE_BATCH_MAX];
+    int64_t             after = 0;
+    int64_t             bucket = -1;
+    int                 removed = 0;
+    int                 n, k, i;
+    int                 rv;
+
+    // packets are stored in time order mostly, walk ends at first packet newer than $before
+    while( (n = backend->scan(after, metas, DATABASE_BATCH_MAX)) > 0 ) {
+        for( i = 0, k = 0; i < n && (!metas[i].time || metas[i].time < before); i++ ) {
+            if( !metas[i].time ) {
+                continue;
+            }
+
+            // samples packet is thinned by it's samples time, it's removed when no sample is left
+            if( (rv = databaseThinSamples(metas[i].id, metas[i].bytes, before, interval, &bucket)) >= 0 ) {
+                if( rv ) {
+                    ids[k++] = metas[i].id;
+                }
+                continue;
+            }
+
+            if( interval && metas[i].time / interval != bucket ) {
+                bucket = metas[i].time / interval;
+                continue;
+            }
+            ids[k++] = metas[i].id;
+        }
+        after = metas[n - 1].id;
 
-    sqlite3_close(db);
-    logWarn("close database success\n");
+        if( k && (rv = databaseStoredDel(ids, k)) < 0 ) {
+            return rv;
+        }
+        removed += k;
+        if( i < n ) {
+            break;
+        }
+    }
 
-    return ;
+    *total += removed;
+    return n < 0 ? n : removed;
+}
+
+
+/* description :    remove oldest stored packets until they are under low water mark of caps
+ * return value:    <0: failure   >=0: packets removed
+ */
+static int databaseDropOldest(void) {
+
+    database_meta_t     metas[DATABASE_BATCH_MAX];
+    int64_t             ids[DATABASE_BATCH_MAX];
+    int64_t             rows, bytes;
+    int                 removed = 0;
+    int                 n, i;
+    int                 rv;
+
+    while( databaseOverCap(stored.rows, stored.bytes, DATABASE_THIN_LOW) && (n = backend->scan(0, metas, DATABASE_BATCH_MAX)) > 0 ) {
+
+        // count packets out before removing, so no more than needed are removed
+        rows = stored.rows;
+        bytes = stored.bytes;
+        for( i = 0; i < n && databaseOverCap(rows, bytes, DATABASE_THIN_LOW); i++ ) {
+            ids[i] = metas[i].id;
+            rows--;
+            bytes -= metas[i].bytes;
+        }
+
+        if( (rv = databaseStoredDel(ids, i)) <= 0 ) {
+            return rv < 0 ? rv : removed;
+        }
+        removed += rv;
+    }
+
+    stored.dropped += removed;
+    return removed;
 }
 
 
-/* description :    push a blob packet into database
+/* description :    keep stored packets under caps, packets older than max age are removed, then
+ *                  older packets are thinned by tiers from oldest tier, and oldest packets are
+ *                  removed at last, until packets are under low water mark of caps
+ * return value:    <0: failure   >=0: packets removed
+ */
+static int databaseRetain(void) {
+
+    int64_t         now = clockNowMs();
+    int64_t         rows = stored.rows;
+    int             i;
+    int             rv = 0;
+
+    if( options.max_age > 0 ) {
+        stored.expire_ms = clockMonoMs();
+        rv = databaseRetainWalk(now - options.max_age * 1000LL, 0, &stored.expired);
+    }
+
+    for( i = options.nthin - 1; rv >= 0 && i >= 0 && databaseOverCap(stored.rows, stored.bytes, DATABASE_THIN_LOW); i-- ) {
+        rv = databaseRetainWalk(now - options.thin[i].age * 1000LL, options.thin[i].interval * 1000LL, &stored.thinned);
+    }
+
+    if( rv >= 0 && databaseOverCap(stored.rows, stored.bytes, DATABASE_THIN_LOW) ) {
+        rv = databaseDropOldest();
+    }
+
+    if( rv < 0 ) {
+        logError("database retention failure\n");
+        return rv;
+    }
+
+    if( rows != stored.rows ) {
+        logWarn("database retention removes %lld packets, %lld packets %lld bytes stored\n",
+                (long long)(rows - stored.rows), (long long)stored.rows, (long long)stored.bytes);
+    }
+
+    return (int)(rows - stored.rows);
+}
+
+
+/* description :    write a packet to storage backend and count it in, retention runs when
+ *                  stored packets pass caps
+ *  input args :
+ *         $id :    blob packet record id
+ *       $time :    blob packet time, epoch milliseconds, first sample time or push time
+ *       $pack :    blob packet data address
+ *       $size :    blob packet data bytes
+ * return value:    <0: failure   0: success
+ */
+static int databaseStoredInsert(int64_t id, int64_t time, void *pack, int size) {
+
+    if( backend->insert(id, time, pack, size) < 0 ) {
+        return -1;
+    }
+    stored.rows++;
+    stored.bytes += size;
+
+    if( databaseOverCap(stored.rows, stored.bytes, 100) ) {
+        databaseRetain();
+    }
+
+    return 0;
+}
+
+
+/* description :    drop removed packets at head of memory ring */
+static void databaseRingTrim(void) {
+
+    while( ring.count && !ring.slot[ring.head].data ) {
+        ring.head = (ring.head + 1) % DATABASE_RING_SLOTS;
+        ring.count--;
+    }
+
+    return;
+}
+
+
+/* description :    spill oldest packet in memory ring to storage backend
+ * return value:    <0: failure   0: success
+ */
+static int databaseRingSpill(void) {
+
+    database_ring_t     *slot;
+
+    databaseRingTrim();
+    if( !ring.count ) {
+        return 0;
+    }
+    slot = &ring.slot[ring.head];
+
+    // packet stays in memory when it can't be written, it's tried again next time
+    if( databaseStoredInsert(slot->id, slot->time, slot->data, slot->bytes) < 0 ) {
+        return -1;
+    }
+
+    ring.bytes -= slot->bytes;
+    ring.spilled++;
+    free(slot->data);
+    slot->data = NULL;
+    databaseRingTrim();
+
+    return 0;
+}
+
+
+/* description :    find packet in memory ring
+ *  input args :
+ *         $id :    blob packet record id
+ * return value:    NULL: not in memory   others: ring slot
+ */
+static database_ring_t *databaseRingFind(int64_t id) {
+
+    database_ring_t     *slot;
+    int64_t             off;
+
+    if( !ring.count ) {
+        return NULL;
+    }
+
+    off = id - ring.slot[ring.head].id;
+    if( off < 0 || off >= ring.count ) {
+        return NULL;
+    }
+    slot = &ring.slot[(ring.head + off) % DATABASE_RING_SLOTS];
+
+    return slot->data ? slot : NULL;
+}
+
+
+/* description :    remove packet from memory ring
+ *  input args :
+ *         $id :    blob packet record id
+ * return value:    0: not in memory   1: removed
+ */
+static int databaseRingRemove(int64_t id) {
+
+    database_ring_t     *slot = databaseRingFind(id);
+
+    if( !slot ) {
+        return 0;
+    }
+
+    ring.bytes -= slot->bytes;
+    ring.absorbed++;
+    free(slot->data);
+    slot->data = NULL;
+    databaseRingTrim();
+    logDebug("remove blob packet[%lld] from memory\n", (long long)id);
+
+    return 1;
+}
+
+
+/* description :    spill packets in memory ring which reach age limit to storage backend, and
+ *                  commit pushed packets which reach row or time limit, call it periodically
+ *  input args :
+ *        $all :    1: spill all packets in memory ring, at shutdown   0: spill aged packets only
+ * return value:    <0: failure   0: success
+ */
+int databaseFlush(int all) {
+
+    int64_t         now = clockMonoMs();
+
+    if( !backend ) {
+        logError("database not been opened\n");
+        return -1;
+    }
+
+    databaseRingTrim();
+    while( ring.count && (all || now - ring.slot[ring.head].ms >= options.ring_ms) ) {
+        if( databaseRingSpill() < 0 ) {
+            return -2;
+        }
+    }
+
+    // packets older than max age are removed though caps are not reached
+    if( options.max_age > 0 && now - stored.expire_ms >= DATABASE_EXPIRE_MS ) {
+        stored.expire_ms = now;
+        databaseRetainWalk(clockNowMs() - options.max_age * 1000LL, 0, &stored.expired);
+    }
+
+    return databaseCommit(0);
+}
+
+
+/* description :    get time a packet is stored with, packet_time option gives it from packet
+ *                  data, so packets pushed late still go by their samples time
+ *  input args :
+ *       $pack :    blob packet data address
+ *       $size :    blob packet data bytes
+ * return value:    epoch milliseconds
+ */
+static int64_t databasePacketTime(void *pack, int size) {
+
+    int64_t         time = options.packet_time ? options.packet_time(pack, size) : 0;
+
+    return time > 0 ? time : clockNowMs();
+}
+
+
+/* description :    push a blob packet, it's kept in memory ring and written to storage backend
+ *                  when memory ring is full, it's too old, or at databaseTerm()
  *  input args :
  *       $pack :    blob packet data address
  *       $size :    blob packet data bytes
@@ -102,9 +569,8 @@ void databaseTerm(void) {
  */
 int databasePushPacket(void *pack, int size) {
 
-    char                sql[SQL_COMMAND_LEN] = {0};
-    int                 rv = 0;
-    sqlite3_stmt        *stat = NULL;
+    database_ring_t     *slot;
+    void                *copy = NULL;
 
     // check input args
     if( !pack || size <= 0 ) {
@@ -112,142 +578,222 @@ int databasePushPacket(void *pack, int size) {
         return -1;
     }
 
-    if( !db ) {
-        logError("sqlite database not been opened\n");
+    if( !backend ) {
+        logError("database not been opened\n");
         return -2;
     }
 
-    // prepare SQL command
-    snprintf(sql, sizeof(sql), "INSERT INTO %s(packet) VALUES(?)", TABLE_NAME);
-    rv = sqlite3_prepare_v2(db, sql, -1, &stat, NULL);
-    if( SQLITE_OK != rv || !stat ) {
-        logError("function sqlite3_prepare_v2() failure when push blob packet\n");
-        rv = -2;
-        goto Cleanup;
-    }
-
-    // bind blob packet data on SQL command
-    if( SQLITE_OK != sqlite3_bind_blob(stat, 1, pack, size, NULL) ) {
-        logError("function sqlite3_bind_blob() failure when push blob packet\n");
-        rv = -3;
-        goto Cleanup;
+    // oldest packets give room to new one
+    databaseRingTrim();
+    while( ring.count && (ring.count == DATABASE_RING_SLOTS || ring.bytes + size > options.ring_bytes) ) {
+        if( databaseRingSpill() < 0 ) {
+            break;
+        }
     }
 
-    // execute SQL command
-    rv = sqlite3_step(stat);
-    if( SQLITE_DONE != rv && SQLITE_ROW != rv ) {
-        logError("function sqlite3_step() failure when push blob packet\n");
-        rv = -4;
-        goto Cleanup;
+    // packet goes to storage backend directly when memory ring can't take it, ring is empty then
+    if( ring.count == DATABASE_RING_SLOTS || ring.bytes + size > options.ring_bytes || !(copy = malloc(size)) ) {
+        while( ring.count && !databaseRingSpill() ) {
+        }
+        if( ring.count ) {
+            free(copy);
+            return -3;
+        }
+        if( databaseStoredInsert(ring.next_id, databasePacketTime(pack, size), pack, size) < 0 ) {
+            free(copy);
+            return -4;
+        }
+        ring.next_id++;
+        free(copy);
+        return 0;
     }
 
- Cleanup:
-    sqlite3_finalize(stat);
+    memcpy(copy, pack, size);
+    slot = &ring.slot[(ring.head + ring.count) % DATABASE_RING_SLOTS];
+    slot->id = ring.next_id++;
+    slot->ms = clockMonoMs();
+    slot->time = databasePacketTime(pack, size);
+    slot->data = copy;
+    slot->bytes = size;
+    ring.count++;
+    ring.bytes += size;
+    logDebug("keep blob packet[%lld] in memory, %d bytes in memory\n", (long long)slot->id, ring.bytes);
 
-    if( rv < 0 ) {
-        logError("add new blob packet into database failure, rv = %d\n", rv);
-    } 
-    else {
-        logInfo("add new blob packet into database success\n");
-    }
-    return rv;
+    return 0;
 }
 
 
-/* description :    pop first blob packet from database
+/* description :    pop first blob packet after a record from database, packet stays in
+ *                  database until it's removed by databaseDelPacket()
  *  input args :
+ *      $after :    record id of last popped packet, 0 means pop from first packet
  *       $pack :    blob packet output buffer address
  *       $size :    blob packet output buffer size
  *       $byte :    blob packet data bytes
+ *         $id :    blob packet record id
  * return value:    <0: failure   0: success
  */
-int databasePopPacket(void *pack, int size, int *bytes) {
+int databasePopPacket(int64_t after, void *pack, int size, int *bytes, int64_t *id) {
 
-    char                sql[SQL_COMMAND_LEN] = {0};
+    database_pack_t     one;
     int                 rv = 0;
-    sqlite3_stmt        *stat = NULL;
-    const void          *blob_ptr;
 
     // check input args
-    if( !pack || size <= 0 || !bytes ) {
+    if( !pack || size <= 0 || !bytes || !id ) {
         logError("function %s() gets invalid input arguments\n", __func__);
         return -1;
     }
 
-    if( !db ) {
-        logError("sqlite database not been opened\n");
-        return -2;
+    rv = databasePopPackets(after, &one, 1, pack, size);
+    if( rv <= 0 ) {
+        return rv < 0 ? rv : -6;
     }
 
-    // only query first packet record
-    snprintf(sql, sizeof(sql), "SELECT packet FROM %s WHERE rowid = (SELECT rowid FROM %s LIMIT 1);", TABLE_NAME, TABLE_NAME);
-    // prepare SQL command
-    rv = sqlite3_prepare_v2(db, sql, -1, &stat, NULL);
-    if( SQLITE_OK != rv || !stat ) {
-        logError("function sqlite3_prepare_v2() failure when pop blob packet\n");
-        rv = -3;
-        goto Cleanup;
-    }
+    *id = one.id;
+    *bytes = one.bytes;
+
+    return 0;
+}
+
+
+/* description :    pop blob packets after a record from database, packets stay in database
+ *                  until they're removed by databaseDelPackets()
+ *  input args :
+ *      $after :    record id of last popped packet, 0 means pop from first packet
+ *      $packs :    popped packets output, data points into $buf
+ *      $count :    most packets popped, at most DATABASE_BATCH_MAX
+ *        $buf :    blob packets data output buffer, packets which don't fit are left for next pop
+ *       $size :    blob packets data output buffer size
+ * return value:    <0: failure   0: no packet   >0: packets popped
+ */
+int databasePopPackets(int64_t after, database_pack_t *packs, int count, void *buf, int size) {
+
+    int                 n = 0;
+    int                 i;
+    int                 more = 0;
+    int                 used = 0;
+    database_ring_t     *slot;
 
-    // execute SQL command
-    rv = sqlite3_step(stat);
-    if( SQLITE_DONE != rv && SQLITE_ROW != rv ) {
-        logError("function sqlite3_step() failure when pop blob packet\n");
-        rv = -4;
-        goto Cleanup;
+    // check input args
+    if( !packs || count <= 0 || !buf || size <= 0 ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
+        return -1;
     }
 
-    // 0 means first column in this row
-    blob_ptr = sqlite3_column_blob(stat, 0);
-    if( !blob_ptr ) {
-        rv = -6;
-        goto Cleanup;
+    if( !backend ) {
+        logError("database not been opened\n");
+        return -2;
     }
 
-    *bytes = sqlite3_column_bytes(stat, 0);
+    if( count > DATABASE_BATCH_MAX ) {
+        count = DATABASE_BATCH_MAX;
+    }
 
-    if( *bytes > size ) {
-        logError("blob packet bytes[%d] is larger than bufsize[%d]\n", *bytes, size);
-        *bytes = 0;
-        rv = -7;
-        goto Cleanup;
+    // packets in storage backend are older, they are popped first
+    if( (n = backend->pop(after, packs, count, buf, size, &more)) < 0 ) {
+        return n;
+    }
+    for( i = 0; i < n; i++ ) {
+        used += packs[i].bytes;
     }
 
-    memcpy(pack, blob_ptr, *bytes);
-    rv = 0;
+    // then packets in memory ring, when storage backend has no more
+    for( i = 0; !more && n < count && i < ring.count; i++ ) {
+        slot = &ring.slot[(ring.head + i) % DATABASE_RING_SLOTS];
+        if( !slot->data || slot->id <= after ) {
+            continue;
+        }
+        if( used + slot->bytes > size ) {
+            if( !n ) {
+                logError("blob packet bytes[%d] is larger than bufsize[%d]\n", slot->bytes, size);
+                return -7;
+            }
+            break;
+        }
+
+        packs[n].id = slot->id;
+        packs[n].data = (char *)buf + used;
+        packs[n].bytes = slot->bytes;
+        memcpy(packs[n].data, slot->data, slot->bytes);
+        used += slot->bytes;
+        n++;
+    }
 
- Cleanup:
-    sqlite3_finalize(stat);
-    return rv;
+    return n;
 }
 
 
-/* description :    remove first blob packet from database
+/* description :    remove a blob packet from database
+ *  input args :
+ *         $id :    blob packet record id
  *return value :    <0: failure   0: success
  */
-int databaseDelPacket(void) {
+int databaseDelPacket(int64_t id) {
+
+    return databaseDelPackets(&id, 1);
+}
+
+
+/* description :    remove blob packets from database in one transaction
+ *  input args :
+ *        $ids :    blob packet record ids
+ *      $count :    record ids count
+ * return value:    <0: failure   0: success
+ */
+int databaseDelPackets(int64_t *ids, int count) {
 
-    char        sql[SQL_COMMAND_LEN] = {0};
-    char        *errmsg = NULL;
+    int64_t     backlog[DATABASE_BATCH_MAX];
+    int         n = 0;
+    int         i;
 
-    if( !db ) {
-        logError("sqlite database not been opened\n");
+    // check input args
+    if( !ids || count < 0 ) {
+        logError("function %s() gets invalid input arguments\n", __func__);
         return -1;
     }
 
-    // remove packet from database
-    memset(sql, 0, sizeof(sql));
-    snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE rowid = (SELECT rowid FROM %s LIMIT 1);", TABLE_NAME, TABLE_NAME);
-    if( SQLITE_OK != sqlite3_exec(db, sql, NULL, 0, &errmsg) )
-    {
-        logError("delete first blob packet from database failure: %s\n", errmsg);
-        sqlite3_free(errmsg);
+    if( !backend ) {
+        logError("database not been opened\n");
         return -2;
     }
-    logWarn("delete first blob packet from database success\n");
 
-    // vacuum database
-    sqlite3_exec(db, "VACUUM;", NULL, 0, NULL);
+    for( i = 0; i < count; i++ ) {
+
+        // packet in memory never reaches storage backend
+        if( databaseRingRemove(ids[i]) ) {
+            continue;
+        }
+
+        backlog[n++] = ids[i];
+        if( n == DATABASE_BATCH_MAX ) {
+            if( databaseStoredDel(backlog, n) < 0 ) {
+                return -3;
+            }
+            n = 0;
+        }
+    }
+
+    if( n > 0 && databaseStoredDel(backlog, n) < 0 ) {
+        return -3;
+    }
 
     return 0;
 }
+
+
+/* description :    reclaim space of removed packets in storage backend, call it periodically,
+ *                  it does nothing when there is little to reclaim
+ *  input args :
+ *       $idle :    1: no backlog is draining, reclaim all free pages
+ *                  0: backlog is draining, reclaim a step only if free pages pass threshold
+ * return value:    <0: failure   >=0: pages or segment files reclaimed
+ */
+int databaseVacuum(int idle) {
+
+    if( !backend ) {
+        logError("database not been opened\n");
+        return -1;
+    }
+
+    return backend->vacuum(idle);
+}
@@ -0,0 +1,963 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  dbsegment.c
+ *    Description:  This file is the segment storage backend of database. Packets are
+ *                  appended as length prefixed and CRC checked records to mmap'd fixed
+ *                  size segment files, read from a persisted cursor, and a segment
+ *                  file is removed as a whole when all it's records are removed.
+ *                  Segments thinned by retention are compacted in pairs by vacuum,
+ *                  so files on disk stay below twice the live records plus two.
+ *                 
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时19分11秒"
+ *                 
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "database.h"
+#include "logger.h"
+#include "clock.h"
+
+#define DBSEGMENT_PATH_LEN      256
+#define DBSEGMENT_CURSOR_MAGIC  0x43474553  // "SEGC"
+#define DBSEGMENT_DELETED       0x1         // record flag, record is removed
+
+// record header, packet data follows it and record is padded to 8 bytes
+typedef struct dbsegment_rec_s {
+    uint32_t            bytes;              // packet data bytes, 0 means end of records in segment
+    uint32_t            crc;                // CRC32 of record id and packet data
+    int64_t             id;                 // record id
+    uint32_t            flags;              // DBSEGMENT_DELETED
+    uint32_t            time;               // epoch seconds of packet, 0 means unknown
+}dbsegment_rec_t;
+
+// read cursor file content, records before it in oldest segment are removed
+typedef struct dbsegment_cursor_s {
+    uint32_t            magic;              // DBSEGMENT_CURSOR_MAGIC
+    uint32_t            seq;                // oldest segment sequence
+    uint32_t            off;                // offset in oldest segment
+    uint32_t            check;              // magic ^ seq ^ off
+}dbsegment_cursor_t;
+
+typedef struct dbsegment_seg_s {
+    uint32_t            seq;                // segment file sequence
+    int                 fd;                 // segment file
+    char                *map;               // segment file mapping
+    uint32_t            end;                // bytes of records
+    int                 live;               // records not removed
+    uint32_t            live_bytes;         // bytes of records not removed, headers included
+    int64_t             last_id;            // id of last record, 0 means no record
+    uint32_t            scan;               // offset where last removed record was found
+    int                 dirty;              // written since last commit
+}dbsegment_seg_t;
+
+// where a walk in record id order stopped, so next walk continues from there
+typedef struct dbsegment_hint_s {
+    uint32_t            seq;                // segment of last record walked
+    uint32_t            off;                // offset of last record walked
+    int64_t             id;                 // id of last record walked, 0 means no hint
+}dbsegment_hint_t;
+
+/* Use static global handler in order to simplify API,
+ * but it will make this library not thread safe
+ */
+static struct {
+    char                prefix[DBSEGMENT_PATH_LEN]; // segment files name prefix
+    database_opt_t      opt;                // database options
+    dbsegment_seg_t     seg[DATABASE_SEGMENT_MAX]; // segments from oldest one, last one is written
+    int                 count;              // segments
+    uint32_t            next_seq;           // sequence of next new segment
+    uint32_t            cursor;             // offset in oldest segment, records before it are removed
+    int                 cursor_fd;          // read cursor file
+    int                 pending;            // records written or removed since last commit
+    int64_t             first_ms;           // time of first record written or removed since last commit
+    dbsegment_hint_t    pop;                // last popped record
+    dbsegment_hint_t    scan;               // last scanned record
+    int64_t             removed;            // segment files removed
+} spool = { .cursor_fd = -1 };
+
+static uint32_t         crc_table[256];
+
+
+/*	description:	CRC32(IEEE 802.3) of data
+ *	 input args:	
+ *					$crc  : CRC of data before, 0 for first data
+ *					$data : data
+ *					$bytes: data bytes
+ * return value:    CRC
+ */
+static uint32_t dbsegmentCrc(uint32_t crc, const void *data, int bytes) {
+
+    const uint8_t       *p = data;
+    uint32_t            c;
+    int                 i, k;
+
+    if( !crc_table[1] ) {
+        for( i = 0; i < 256; i++ ) {
+            for( c = i, k = 0; k < 8; k++ ) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            crc_table[i] = c;
+        }
+    }
+
+    crc = ~crc;
+    for( i = 0; i < bytes; i++ ) {
+        crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+
+/*	description:	get record bytes in segment, header and padding included */
+static inline uint32_t dbsegmentRecLen(uint32_t bytes) {
+
+    return (sizeof(dbsegment_rec_t) + bytes + 7) & ~7u;
+}
+
+
+/*	description:	get record at offset of segment
+ * return value:    NULL: no record there   others: record
+ */
+static inline dbsegment_rec_t *dbsegmentRec(dbsegment_seg_t *seg, uint32_t off) {
+
+    return off < seg->end ? (dbsegment_rec_t *)(seg->map + off) : NULL;
+}
+
+
+/*	description:	get segment file path
+ *	 input args:	
+ *					$seq  : segment sequence
+ *					$ext  : "seg" for segment file, "tmp" for compacted file being written
+ *					$path : path output
+ *					$size : path output buffer size
+ */
+static void dbsegmentPath(uint32_t seq, const char *ext, char *path, int size) {
+
+    snprintf(path, size, "%s.%08x.%s", spool.prefix, seq, ext);
+
+    return;
+}
+
+
+/*	description:	map a segment file, it's created when it doesn't exist
+ *	 input args:	
+ *					$seg  : segment, seq is set
+ *					$ext  : file name extension, see dbsegmentPath()
+ * return value:    <0: failure   0: success
+ */
+static int dbsegmentMap(dbsegment_seg_t *seg, const char *ext) {
+
+    char                path[DBSEGMENT_PATH_LEN + 16];
+    struct stat         st;
+
+    dbsegmentPath(seg->seq, ext, path, sizeof(path));
+    seg->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if( seg->fd < 0 ) {
+        logError("open segment file \"%s\" failure: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    // new file or file cut short is filled with zero, zero header ends records
+    if( fstat(seg->fd, &st) < 0 || (st.st_size != DATABASE_SEGMENT_BYTES && ftruncate(seg->fd, DATABASE_SEGMENT_BYTES) < 0) ) {
+        logError("size segment file \"%s\" failure: %s\n", path, strerror(errno));
+        close(seg->fd);
+        return -2;
+    }
+
+    seg->map = mmap(NULL, DATABASE_SEGMENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+    if( seg->map == MAP_FAILED ) {
+        logError("map segment file \"%s\" failure: %s\n", path, strerror(errno));
+        close(seg->fd);
+        return -3;
+    }
+
+    return 0;
+}
+
+
+/*	description:	unmap a segment file, and remove it
+ *	 input args:	
+ *					$seg    : segment
+ *					$remove : 1: remove segment file   0: keep it
+ */
+static void dbsegmentUnmap(dbsegment_seg_t *seg, int remove) {
+
+    char                path[DBSEGMENT_PATH_LEN + 16];
+
+    munmap(seg->map, DATABASE_SEGMENT_BYTES);
+    close(seg->fd);
+    if( remove ) {
+        dbsegmentPath(seg->seq, "seg", path, sizeof(path));
+        unlink(path);
+        spool.removed++;
+        logInfo("remove segment file \"%s\"\n", path);
+    }
+
+    return;
+}
+
+
+/*	description:	unmap a segment, remove it's file and take it out of segments
+ *	 input args:	
+ *					$i    : segment index, read cursor is reset when it's the oldest one
+ */
+static void dbsegmentDrop(int i) {
+
+    dbsegmentUnmap(&spool.seg[i], 1);
+    memmove(&spool.seg[i], &spool.seg[i + 1], (spool.count - i - 1) * sizeof(spool.seg[0]));
+    spool.count--;
+    if( !i ) {
+        spool.cursor = 0;
+    }
+
+    return;
+}
+
+
+/*	description:	scan records of a mapped segment, records end at zero header or first
+ *                  broken record, tail of it is cleared so new records are appended there
+ *	 input args:	
+ *					$seg  : segment
+ *					$from : records before this offset are removed
+ */
+static void dbsegmentScan(dbsegment_seg_t *seg, uint32_t from) {
+
+    dbsegment_rec_t     *rec;
+    uint32_t            off = 0;
+    uint32_t            crc;
+
+    seg->live = 0;
+    seg->live_bytes = 0;
+    seg->last_id = 0;
+    while( off + sizeof(dbsegment_rec_t) <= DATABASE_SEGMENT_BYTES ) {
+        rec = (dbsegment_rec_t *)(seg->map + off);
+        if( !rec->bytes || off + dbsegmentRecLen(rec->bytes) > DATABASE_SEGMENT_BYTES ) {
+            break;
+        }
+        // removed record may be broken by a stop while it's thinned, it's length still holds
+        crc = dbsegmentCrc(0, &rec->id, sizeof(rec->id));
+        if( dbsegmentCrc(crc, rec + 1, rec->bytes) != rec->crc && !(rec->flags & DBSEGMENT_DELETED) ) {
+            logWarn("segment %08x record at %u is broken, records end there\n", seg->seq, off);
+            break;
+        }
+
+        if( off >= from && !(rec->flags & DBSEGMENT_DELETED) ) {
+            seg->live++;
+            seg->live_bytes += dbsegmentRecLen(rec->bytes);
+        }
+        seg->last_id = rec->id;
+        off += dbsegmentRecLen(rec->bytes);
+    }
+
+    seg->end = off;
+    if( off < DATABASE_SEGMENT_BYTES ) {
+        memset(seg->map + off, 0, DATABASE_SEGMENT_BYTES - off);
+    }
+
+    return;
+}
+
+
+/*	description:	move read cursor over removed records, and remove oldest segments which
+ *                  have no record left, segment being written is kept
+ */
+static void dbsegmentAdvance(void) {
+
+    dbsegment_rec_t     *rec;
+    dbsegment_seg_t     *head;
+
+    while( spool.count ) {
+        head = &spool.seg[0];
+        while( (rec = dbsegmentRec(head, spool.cursor)) && (rec->flags & DBSEGMENT_DELETED) ) {
+            spool.cursor += dbsegmentRecLen(rec->bytes);
+        }
+        if( head->live || spool.count == 1 ) {
+            break;
+        }
+
+        // whole segment consumed
+        dbsegmentDrop(0);
+    }
+
+    return;
+}
+
+
+/*	description:	save read cursor in cursor file
+ * return value:    <0: failure   0: success
+ */
+static int dbsegmentSaveCursor(void) {
+
+    dbsegment_cursor_t  cur;
+
+    cur.magic = DBSEGMENT_CURSOR_MAGIC;
+    cur.seq = spool.count ? spool.seg[0].seq : spool.next_seq;
+    cur.off = spool.cursor;
+    cur.check = cur.magic ^ cur.seq ^ cur.off;
+
+    if( pwrite(spool.cursor_fd, &cur, sizeof(cur), 0) != sizeof(cur) ) {
+        logError("save segment read cursor failure: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*	description:	close segment files, read cursor is saved */
+static void dbsegmentClose(void) {
+
+    int                 i;
+
+    if( spool.cursor_fd >= 0 ) {
+        dbsegmentSaveCursor();
+        close(spool.cursor_fd);
+        spool.cursor_fd = -1;
+    }
+
+    for( i = 0; i < spool.count; i++ ) {
+        dbsegmentUnmap(&spool.seg[i], 0);
+    }
+    spool.count = 0;
+    logInfo("segment database removed %lld consumed segment files\n", (long long)spool.removed);
+
+    return ;
+}
+
+
+/*	description:	open segment files and read cursor
+ *	 input args:	
+ *					$fname  : segment files name prefix
+ *					$opt    : database options, defaults filled
+ *					$next_id: record id following the last stored one
+ *					$rows   : stored packets count
+ *					$bytes  : stored packets bytes
+ * return value:    <0: failure   0: success
+ */
+static int dbsegmentOpen(char *fname, database_opt_t *opt, int64_t *next_id, int64_t *rows, int64_t *bytes) {
+
+    char                pattern[DBSEGMENT_PATH_LEN + 16];
+    glob_t              files;
+    dbsegment_cursor_t  cur = {0};
+    dbsegment_seg_t     *seg;
+    dbsegment_rec_t     *rec;
+    uint32_t            off;
+    size_t              i;
+    int                 rv = 0;
+
+    memset(&spool, 0, sizeof(spool));
+    spool.cursor_fd = -1;
+    spool.opt = *opt;
+    strncpy(spool.prefix, fname, sizeof(spool.prefix) - 1);
+
+    snprintf(pattern, sizeof(pattern), "%s.cursor", spool.prefix);
+    spool.cursor_fd = open(pattern, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if( spool.cursor_fd < 0 ) {
+        logError("open segment read cursor file \"%s\" failure: %s\n", pattern, strerror(errno));
+        return -1;
+    }
+    if( pread(spool.cursor_fd, &cur, sizeof(cur), 0) != sizeof(cur) ||
+        cur.magic != DBSEGMENT_CURSOR_MAGIC || cur.check != (cur.magic ^ cur.seq ^ cur.off) ) {
+        memset(&cur, 0, sizeof(cur));
+    }
+    spool.next_seq = cur.seq;
+
+    // glob sorts names, so segments are in sequence order
+    snprintf(pattern, sizeof(pattern), "%s.*.seg", spool.prefix);
+    if( glob(pattern, 0, NULL, &files) == 0 ) {
+        for( i = 0; i < files.gl_pathc && spool.count < DATABASE_SEGMENT_MAX; i++ ) {
+            seg = &spool.seg[spool.count];
+            memset(seg, 0, sizeof(*seg));
+            if( sscanf(files.gl_pathv[i] + strlen(spool.prefix), ".%x.seg", &seg->seq) != 1 ) {
+                continue;
+            }
+
+            // segments before cursor are consumed already
+            if( seg->seq < cur.seq ) {
+                unlink(files.gl_pathv[i]);
+                continue;
+            }
+            if( dbsegmentMap(seg, "seg") < 0 ) {
+                rv = -2;
+                break;
+            }
+            spool.next_seq = seg->seq + 1;
+            dbsegmentScan(seg, seg->seq == cur.seq ? cur.off : 0);
+            if( seg->seq == cur.seq && spool.count == 0 ) {
+                spool.cursor = cur.off < seg->end ? cur.off : seg->end;
+            }
+            spool.count++;
+        }
+        globfree(&files);
+    }
+    if( rv < 0 ) {
+        dbsegmentClose();
+        return rv;
+    }
+
+    // compacted file being written when process stopped is incomplete
+    snprintf(pattern, sizeof(pattern), "%s.*.tmp", spool.prefix);
+    if( glob(pattern, 0, NULL, &files) == 0 ) {
+        for( i = 0; i < files.gl_pathc; i++ ) {
+            unlink(files.gl_pathv[i]);
+        }
+        globfree(&files);
+    }
+
+    /* compaction stopped after compacted file replaced later segment but before earlier one
+     * was removed, records of earlier one are in later one too
+     */
+    for( i = 1; i < (size_t)spool.count; i++ ) {
+        rec = dbsegmentRec(&spool.seg[i], 0);
+        if( rec && rec->id <= spool.seg[i - 1].last_id ) {
+            logWarn("segment %08x records are compacted into segment %08x already\n", spool.seg[i - 1].seq, spool.seg[i].seq);
+            dbsegmentDrop(--i);
+        }
+    }
+
+    dbsegmentAdvance();
+
+    // record ids continue from the last record
+    *next_id = 1;
+    for( i = spool.count; i > 0; i-- ) {
+        if( spool.seg[i - 1].last_id ) {
+            *next_id = spool.seg[i - 1].last_id + 1;
+            break;
+        }
+    }
+
+    // records not removed are stored packets
+    *rows = *bytes = 0;
+    for( i = 0; i < spool.count; i++ ) {
+        for( off = i ? 0 : spool.cursor; (rec = dbsegmentRec(&spool.seg[i], off)); off += dbsegmentRecLen(rec->bytes) ) {
+            if( !(rec->flags & DBSEGMENT_DELETED) ) {
+                (*rows)++;
+                *bytes += rec->bytes;
+            }
+        }
+    }
+
+    logInfo("segment database \"%s\", %d segment files, next record id %lld\n", spool.prefix, spool.count, (long long)*next_id);
+    return 0;
+}
+
+
+/* description :    commit written and removed records, sync them to storage as synchronous
+ *                  level asks and save read cursor
+ *  input args :
+ *      $force :    1: commit now   0: commit only if row or time limit is reached
+ * return value:    <0: failure   0: success
+ */
+static int dbsegmentCommit(int force) {
+
+    int                 i;
+    int                 flags;
+
+    if( !spool.pending ) {
+        return 0;
+    }
+    if( !force && spool.pending < spool.opt.commit_rows && clockMonoMs() - spool.first_ms < spool.opt.commit_ms ) {
+        return 0;
+    }
+
+    /* records are in shared mapping, so they are in page cache as soon as they are written and
+     * survive process crash, syncing only matters on power failure
+     */
+    if( spool.opt.sync != DATABASE_SYNC_OFF ) {
+        flags = (spool.opt.sync == DATABASE_SYNC_FULL) ? MS_SYNC : MS_ASYNC;
+        for( i = 0; i < spool.count; i++ ) {
+            if( spool.seg[i].dirty ) {
+                msync(spool.seg[i].map, DATABASE_SEGMENT_BYTES, flags);
+                spool.seg[i].dirty = 0;
+            }
+        }
+    }
+
+    if( dbsegmentSaveCursor() < 0 ) {
+        return -2;
+    }
+    if( spool.opt.sync == DATABASE_SYNC_FULL ) {
+        fdatasync(spool.cursor_fd);
+    }
+    logDebug("commit %d segment records\n", spool.pending);
+    spool.pending = 0;
+
+    return 0;
+}
+
+
+/* description :    get time until written or removed records must be committed
+ * return value:    -1: no record waits for commit   >=0: milliseconds
+ */
+static int dbsegmentTimeout(void) {
+
+    int64_t         left;
+
+    if( !spool.pending ) {
+        return -1;
+    }
+
+    left = spool.first_ms + spool.opt.commit_ms - clockMonoMs();
+
+    return left > 0 ? (int)left : 0;
+}
+
+
+/* description :    count a written or removed record for group commit */
+static void dbsegmentPending(void) {
+
+    if( !spool.pending++ ) {
+        spool.first_ms = clockMonoMs();
+    }
+    dbsegmentCommit(0);
+
+    return;
+}
+
+
+/* description :    append a packet record to segment being written, new segment is started
+ *                  when it's full
+ *  input args :
+ *         $id :    blob packet record id
+ *       $time :    blob packet time, epoch milliseconds, first sample time or push time
+ *       $pack :    blob packet data address
+ *       $size :    blob packet data bytes
+ * return value:    <0: failure   0: success
+ */
+static int dbsegmentInsert(int64_t id, int64_t time, void *pack, int size) {
+
+    dbsegment_seg_t     *seg = spool.count ? &spool.seg[spool.count - 1] : NULL;
+    dbsegment_rec_t     *rec;
+    uint32_t            len = dbsegmentRecLen(size);
+
+    if( len > DATABASE_SEGMENT_BYTES ) {
+        logError("blob packet bytes[%d] is larger than segment\n", size);
+        return -1;
+    }
+
+    if( !seg || seg->end + len > DATABASE_SEGMENT_BYTES ) {
+        if( spool.count == DATABASE_SEGMENT_MAX ) {
+            logError("segment database is full, %d segments\n", spool.count);
+            return -2;
+        }
+        seg = &spool.seg[spool.count];
+        memset(seg, 0, sizeof(*seg));
+        seg->seq = spool.next_seq;
+        if( dbsegmentMap(seg, "seg") < 0 ) {
+            return -3;
+        }
+        memset(seg->map, 0, DATABASE_SEGMENT_BYTES);
+        spool.next_seq++;
+        if( !spool.count ) {
+            spool.cursor = 0;
+        }
+        spool.count++;
+    }
+
+    // data first, header bytes ends records until it's written
+    rec = (dbsegment_rec_t *)(seg->map + seg->end);
+    memcpy(rec + 1, pack, size);
+    rec->id = id;
+    rec->flags = 0;
+    rec->time = (uint32_t)(time / 1000);
+    rec->crc = dbsegmentCrc(dbsegmentCrc(0, &rec->id, sizeof(rec->id)), pack, size);
+    rec->bytes = size;
+
+    seg->end += len;
+    seg->live++;
+    seg->live_bytes += len;
+    seg->last_id = id;
+    seg->dirty = 1;
+    dbsegmentPending();
+
+    return 0;
+}
+
+
+/* description :    find where a walk in record id order starts, it continues from last walked
+ *                  record when ids ascend as drain and retention walk
+ *  input args :
+ *       $hint :    last walked record
+ *      $after :    record id walk starts after
+ *        $off :    offset in returned segment where walk starts
+ * return value:    index of segment where walk starts
+ */
+static int dbsegmentSeek(dbsegment_hint_t *hint, int64_t after, uint32_t *off) {
+
+    int                 i = 0;
+
+    *off = spool.cursor;
+    if( hint->id && hint->id <= after ) {
+        for( i = 0; i < spool.count && spool.seg[i].seq != hint->seq; i++ ) {
+        }
+        if( i < spool.count && (i || hint->off >= spool.cursor) ) {
+            *off = hint->off;
+        }
+        else {
+            i = 0;
+        }
+    }
+
+    return i;
+}
+
+
+/* description :    pop packet records after a record
+ *  input args :
+ *      $after :    record id of last popped packet
+ *      $packs :    popped packets output, data points into $buf
+ *      $count :    most packets popped
+ *        $buf :    blob packets data output buffer
+ *       $size :    blob packets data output buffer size
+ *       $more :    set when there are packets left after popped ones
+ * return value:    <0: failure   >=0: packets popped
+ */
+static int dbsegmentPop(int64_t after, database_pack_t *packs, int count, void *buf, int size, int *more) {
+
+    dbsegment_seg_t     *seg;
+    dbsegment_rec_t     *rec = NULL;
+    int                 n = 0;
+    int                 used = 0;
+    int                 i;
+    uint32_t            off;
+
+    *more = 0;
+
+    // continue from last popped record, drain pops with ascending cursor
+    for( i = dbsegmentSeek(&spool.pop, after, &off); i < spool.count; i++, off = 0 ) {
+        seg = &spool.seg[i];
+
+        // segment records are all popped already
+        if( seg->last_id <= after ) {
+            continue;
+        }
+
+        for( ; (rec = dbsegmentRec(seg, off)); off += dbsegmentRecLen(rec->bytes) ) {
+            if( (rec->flags & DBSEGMENT_DELETED) || rec->id <= after ) {
+                continue;
+            }
+            if( n == count || used + (int)rec->bytes > size ) {
+                *more = 1;
+                break;
+            }
+
+            packs[n].id = rec->id;
+            packs[n].data = (char *)buf + used;
+            packs[n].bytes = rec->bytes;
+            memcpy(packs[n].data, rec + 1, rec->bytes);
+            used += rec->bytes;
+            n++;
+
+            spool.pop.seq = seg->seq;
+            spool.pop.off = off;
+            spool.pop.id = rec->id;
+        }
+        if( *more ) {
+            break;
+        }
+    }
+
+    if( !n && *more ) {
+        logError("blob packet bytes[%d] is larger than bufsize[%d]\n", rec->bytes, size);
+        return -7;
+    }
+
+    return n;
+}
+
+
+/* description :    get information of packet records after a record
+ *  input args :
+ *      $after :    record id of last packet
+ *      $metas :    packets information output
+ *      $count :    most packets
+ * return value:    <0: failure   >=0: packets count
+ */
+static int dbsegmentMetas(int64_t after, database_meta_t *metas, int count) {
+
+    dbsegment_seg_t     *seg;
+    dbsegment_rec_t     *rec;
+    int                 n = 0;
+    int                 i;
+    uint32_t            off;
+
+    for( i = dbsegmentSeek(&spool.scan, after, &off); i < spool.count && n < count; i++, off = 0 ) {
+        seg = &spool.seg[i];
+        if( seg->last_id <= after ) {
+            continue;
+        }
+
+        for( ; n < count && (rec = dbsegmentRec(seg, off)); off += dbsegmentRecLen(rec->bytes) ) {
+            if( (rec->flags & DBSEGMENT_DELETED) || rec->id <= after ) {
+                continue;
+            }
+
+            metas[n].id = rec->id;
+            metas[n].time = (int64_t)rec->time * 1000;
+            metas[n].bytes = rec->bytes;
+            n++;
+
+            spool.scan.seq = seg->seq;
+            spool.scan.off = off;
+            spool.scan.id = rec->id;
+        }
+    }
+
+    return n;
+}
+
+
+/* description :    remove packet records, they are marked removed in segment, and segment file is
+ *                  removed when all it's records are removed
+ *  input args :
+ *        $ids :    blob packet record ids
+ *      $count :    record ids count
+ *      $bytes :    removed packets bytes
+ * return value:    <0: failure   >=0: packets removed
+ */
+static int dbsegmentDel(int64_t *ids, int count, int64_t *bytes) {
+
+    dbsegment_seg_t     *seg;
+    dbsegment_rec_t     *rec;
+    uint32_t            off;
+    int                 i, k;
+    int                 removed = 0;
+
+    *bytes = 0;
+    for( k = 0; k < count; k++ ) {
+
+        // segments are in id order
+        for( i = 0; i < spool.count && spool.seg[i].last_id < ids[k]; i++ ) {
+        }
+        if( i == spool.count ) {
+            continue;
+        }
+        seg = &spool.seg[i];
+
+        // acknowledgements are mostly in order, search from where last one was found
+        off = (seg->scan < seg->end && ((dbsegment_rec_t *)(seg->map + seg->scan))->id <= ids[k]) ? seg->scan : 0;
+        if( !i && off < spool.cursor ) {
+            off = spool.cursor;
+        }
+        for( ; (rec = dbsegmentRec(seg, off)) && rec->id < ids[k]; off += dbsegmentRecLen(rec->bytes) ) {
+        }
+        if( !rec || rec->id != ids[k] || (rec->flags & DBSEGMENT_DELETED) ) {
+            continue;
+        }
+
+        rec->flags |= DBSEGMENT_DELETED;
+        seg->scan = off;
+        seg->live--;
+        seg->live_bytes -= dbsegmentRecLen(rec->bytes);
+        seg->dirty = 1;
+        *bytes += rec->bytes;
+        removed++;
+        dbsegmentPending();
+    }
+
+    dbsegmentAdvance();
+    logInfo("delete %d blob packets from segment database\n", removed);
+
+    return removed;
+}
+
+
+/* description :    replace data of a packet record by thinned one in place, record is cut to new
+ *                  length and space left is a removed record, so it's compacted by vacuum. record
+ *                  is marked removed while it's rewritten, a stop in between loses it only
+ *  input args :
+ *         $id :    blob packet record id
+ *       $pack :    new blob packet data address
+ *       $size :    new blob packet data bytes
+ *      $bytes :    bytes freed
+ * return value:    <0: failure   0: success
+ */
+static int dbsegmentUpdate(int64_t id, void *pack, int size, int64_t *bytes) {
+
+    dbsegment_seg_t     *seg;
+    dbsegment_rec_t     *rec;
+    dbsegment_rec_t     *gap;
+    uint32_t            off;
+    uint32_t            len;
+    uint32_t            left;
+    int                 i;
+
+    for( i = 0; i < spool.count && spool.seg[i].last_id < id; i++ ) {
+    }
+    if( i == spool.count ) {
+        return -2;
+    }
+    seg = &spool.seg[i];
+
+    for( off = i ? 0 : spool.cursor; (rec = dbsegmentRec(seg, off)) && rec->id < id; off += dbsegmentRecLen(rec->bytes) ) {
+    }
+    if( !rec || rec->id != id || (rec->flags & DBSEGMENT_DELETED) ) {
+        return -2;
+    }
+
+    // space left must hold a removed record with data, zero length ends records
+    len = dbsegmentRecLen(size);
+    left = dbsegmentRecLen(rec->bytes) - len;
+    if( size <= 0 || (uint32_t)size >= rec->bytes || left <= sizeof(dbsegment_rec_t) ) {
+        return -3;
+    }
+
+    rec->flags |= DBSEGMENT_DELETED;
+
+    gap = (dbsegment_rec_t *)((char *)rec + len);
+    gap->id = id;
+    gap->flags = DBSEGMENT_DELETED;
+    gap->time = rec->time;
+    gap->crc = 0;
+    gap->bytes = left - sizeof(dbsegment_rec_t);
+
+    memcpy(rec + 1, pack, size);
+    rec->crc = dbsegmentCrc(dbsegmentCrc(0, &rec->id, sizeof(rec->id)), pack, size);
+    *bytes = rec->bytes - size;
+    rec->bytes = size;
+    rec->flags = 0;
+
+    seg->live_bytes -= left;
+    seg->dirty = 1;
+    dbsegmentPending();
+
+    return 0;
+}
+
+
+/*	description:	compact records left in two adjacent segments into one file, the file is
+ *                  written aside and renamed over later segment before earlier one is removed,
+ *                  so records stay in id order and a stop in between leaves them twice only
+ *	 input args:	
+ *					$i    : index of earlier segment, neither segment is the one written
+ * return value:    <0: failure   0: success
+ */
+static int dbsegmentMerge(int i) {
+
+    char                tmp[DBSEGMENT_PATH_LEN + 16];
+    char                path[DBSEGMENT_PATH_LEN + 16];
+    dbsegment_seg_t     merged = {0};
+    dbsegment_seg_t     *seg;
+    dbsegment_rec_t     *rec;
+    uint32_t            off;
+    uint32_t            len;
+    int                 k;
+
+    merged.seq = spool.seg[i + 1].seq;
+    dbsegmentPath(merged.seq, "tmp", tmp, sizeof(tmp));
+    dbsegmentPath(merged.seq, "seg", path, sizeof(path));
+    unlink(tmp);
+    if( dbsegmentMap(&merged, "tmp") < 0 ) {
+        return -1;
+    }
+
+    for( k = i; k <= i + 1; k++ ) {
+        seg = &spool.seg[k];
+        for( off = (k == 0) ? spool.cursor : 0; (rec = dbsegmentRec(seg, off)); off += len ) {
+            len = dbsegmentRecLen(rec->bytes);
+            if( rec->flags & DBSEGMENT_DELETED ) {
+                continue;
+            }
+            memcpy(merged.map + merged.end, rec, len);
+            merged.end += len;
+            merged.live++;
+            merged.live_bytes += len;
+            merged.last_id = rec->id;
+        }
+    }
+
+    // compacted records must be on storage before the files holding them now are gone
+    if( spool.opt.sync != DATABASE_SYNC_OFF && (msync(merged.map, DATABASE_SEGMENT_BYTES, MS_SYNC) < 0 || fsync(merged.fd) < 0) ) {
+        logError("sync segment file \"%s\" failure: %s\n", tmp, strerror(errno));
+        goto Failure;
+    }
+    if( rename(tmp, path) < 0 ) {
+        logError("rename segment file \"%s\" failure: %s\n", tmp, strerror(errno));
+        goto Failure;
+    }
+
+    logInfo("compact segments %08x and %08x into %d records\n", spool.seg[i].seq, merged.seq, merged.live);
+    dbsegmentUnmap(&spool.seg[i + 1], 0);
+    spool.seg[i + 1] = merged;
+    dbsegmentDrop(i);
+
+    return 0;
+
+ Failure:
+    dbsegmentUnmap(&merged, 0);
+    unlink(tmp);
+
+    return -2;
+}
+
+
+/* description :    reclaim space of removed records, segment with no record left is removed and
+ *                  two adjacent segments whose records fit in one are compacted, segment being
+ *                  written is left alone
+ *  input args :
+ *       $idle :    1: no backlog is draining, compact all segments
+ *                  0: backlog is draining, compact a pair of segments at most
+ * return value:    <0: failure   >=0: segment files removed
+ */
+static int dbsegmentVacuum(int idle) {
+
+    int                 i = 0;
+    int                 n = 0;
+    int                 rv = 0;
+
+    while( i < spool.count - 1 ) {
+        if( !spool.seg[i].live ) {
+            dbsegmentDrop(i);
+            n++;
+            continue;
+        }
+
+        // compacted segment may take records of next one too, so stay on it
+        if( (idle || !n) && i < spool.count - 2 &&
+            spool.seg[i].live_bytes + spool.seg[i + 1].live_bytes <= DATABASE_SEGMENT_BYTES ) {
+            if( (rv = dbsegmentMerge(i)) < 0 ) {
+                break;
+            }
+            n++;
+            continue;
+        }
+        i++;
+    }
+
+    // walks stopped in segments moved or removed
+    if( n ) {
+        spool.pop.id = 0;
+        spool.scan.id = 0;
+        dbsegmentSaveCursor();
+    }
+
+    return rv < 0 ? rv : n;
+}
+
+
+database_backend_t dbsegment_backend = {
+    .name = "segment",
+    .open = dbsegmentOpen,
+    .close = dbsegmentClose,
+    .insert = dbsegmentInsert,
+    .pop = dbsegmentPop,
+    .scan = dbsegmentMetas,
+    .del = dbsegmentDel,
+    .update = dbsegmentUpdate,
+    .commit = dbsegmentCommit,
+    .timeout = dbsegmentTimeout,
+    .vacuum = dbsegmentVacuum,
+};
@@ -0,0 +1,613 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  dbsqlite.c
+ *    Description:  This file is the sqlite storage backend of database, packets are
+ *                  rows of a table in WAL mode, inserted in group commit.
+ *                 
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时19分11秒"
+ *                 
+ ********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include "database.h"
+#include "logger.h"
+#include "clock.h"
+
+// Blob packet table name
+#define TABLE_NAME     "PackTable"
+
+/* Use static global handler in order to simplify API,
+ * but it will make this library not thread safe
+ */
+static sqlite3         *db = NULL;
+
+// statements prepared once in dbsqliteOpen(), reset after every use
+static struct {
+    sqlite3_stmt        *push;              // insert a packet with it's record id
+    sqlite3_stmt        *popn;              // select packets after a rowid
+    sqlite3_stmt        *scan;              // select packets information after a rowid
+    sqlite3_stmt        *size;              // select packet bytes by rowid
+    sqlite3_stmt        *del;               // delete a packet by rowid
+    sqlite3_stmt        *update;            // replace a packet by rowid
+    sqlite3_stmt        *freelist;          // count free pages
+} stmt;
+
+// group commit of inserted packets
+static struct {
+    database_opt_t      opt;                // database options
+    int                 pending;            // inserted packets in open transaction
+    int64_t             first_ms;           // time of transaction began
+} group;
+
+// incremental vacuum metrics
+static struct {
+    int64_t             runs;               // vacuum steps executed
+    int64_t             pages;              // pages reclaimed in total
+} vacuum;
+
+
+/*	description:	prepare a statement into cache
+ *	 input args:	
+ *					$fmt  : SQL command format, %s is table name
+ *					$stat : statement output
+ * return value:    <0: failure   0: success
+ */
+static int dbsqlitePrepare(const char *fmt, sqlite3_stmt **stat) {
+
+    char               sql[SQL_COMMAND_LEN] = {0};
+
+    snprintf(sql, sizeof(sql), fmt, TABLE_NAME);
+    if( SQLITE_OK != sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, stat, NULL) ) {
+        logError("prepare \"%s\" failure: %s\n", sql, sqlite3_errmsg(db));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*	description:	reset a cached statement for next use
+ *	 input args:	
+ *					$stat : statement
+ */
+static void dbsqliteReset(sqlite3_stmt *stat) {
+
+    sqlite3_reset(stat);
+    sqlite3_clear_bindings(stat);
+
+    return;
+}
+
+
+/*	description:	get record id following the last record, and stored packets count and bytes,
+ *                  it runs once at open, packets are counted by caller later
+ *	 input args:	
+ *					$next_id: record id following the last stored one
+ *					$rows   : stored packets count
+ *					$bytes  : stored packets bytes
+ * return value:    <0: failure   0: success
+ */
+static int dbsqliteCount(int64_t *next_id, int64_t *rows, int64_t *bytes) {
+
+    char               sql[SQL_COMMAND_LEN] = {0};
+    sqlite3_stmt       *stat = NULL;
+    int                rv = -1;
+
+    snprintf(sql, sizeof(sql), "SELECT IFNULL(MAX(rowid), 0) + 1, COUNT(*), IFNULL(SUM(LENGTH(packet)), 0) FROM %s;", TABLE_NAME);
+    if( SQLITE_OK == sqlite3_prepare_v2(db, sql, -1, &stat, NULL) && SQLITE_ROW == sqlite3_step(stat) ) {
+        *next_id = sqlite3_column_int64(stat, 0);
+        *rows = sqlite3_column_int64(stat, 1);
+        *bytes = sqlite3_column_int64(stat, 2);
+        rv = 0;
+    }
+    sqlite3_finalize(stat);
+
+    return rv;
+}
+
+
+/*	description:	close sqlite database file */
+static void dbsqliteClose(void) {
+
+    sqlite3_finalize(stmt.push);
+    sqlite3_finalize(stmt.popn);
+    sqlite3_finalize(stmt.scan);
+    sqlite3_finalize(stmt.size);
+    sqlite3_finalize(stmt.del);
+    sqlite3_finalize(stmt.update);
+    sqlite3_finalize(stmt.freelist);
+    memset(&stmt, 0, sizeof(stmt));
+
+    sqlite3_close(db);
+    db = NULL;
+    logInfo("database vacuum reclaimed %lld pages in %lld steps\n", (long long)vacuum.pages, (long long)vacuum.runs);
+
+    return ;
+}
+
+
+/*	description:	open sqlite database file, create it when it doesn't exist
+ *	 input args:	
+ *					$fname  : database file name
+ *					$opt    : database options, defaults filled
+ *					$next_id: record id following the last stored one
+ *					$rows   : stored packets count
+ *					$bytes  : stored packets bytes
+ * return value:    <0: failure   0: success
+ */
+static int dbsqliteOpen(char *fname, database_opt_t *opt, int64_t *next_id, int64_t *rows, int64_t *bytes) {
+
+    char               sql[SQL_COMMAND_LEN] = {0};
+    char               *errmsg = NULL;
+    sqlite3_stmt       *stat = NULL;
+    int                exist = 0;
+    static const char  *sync_names[] = {"OFF", "NORMAL", "FULL"};
+
+    // database file already exist, then open it, otherwise create and init it
+    exist = (0 == access(fname, F_OK));
+    if( SQLITE_OK != sqlite3_open(fname, &db) ) {
+        logError("%s() failed: %s\n", __func__, sqlite3_errmsg(db));
+        return -2;
+    }
+
+    memset(&group, 0, sizeof(group));
+    group.opt = *opt;
+
+    if( !exist ) {
+        /* enable incremental auto vacuum, it only takes effect before the first table is created
+         * and before switching to WAL writes the file header
+         */
+        sqlite3_exec(db, "pragma auto_vacuum = 2 ; ", NULL, NULL, NULL);
+
+        // create table in the database
+        snprintf(sql, sizeof(sql), "CREATE TABLE %s(packet BLOB, ts INTEGER DEFAULT 0);", TABLE_NAME);
+        if( SQLITE_OK != sqlite3_exec(db, sql, NULL, NULL, &errmsg) ) {
+            logError("create datatable in database file '%s' failure: %s\n", fname, errmsg);
+            // free errmsg
+            sqlite3_free(errmsg);
+            // close databse
+            sqlite3_close(db);
+            db = NULL;
+            // remove database file
+            unlink(fname);
+            return -3;
+        }
+    }
+    else {
+        // file of older version has no time column, it's packets are of unknown time
+        snprintf(sql, sizeof(sql), "SELECT ts FROM %s LIMIT 0;", TABLE_NAME);
+        if( SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stat, NULL) ) {
+            snprintf(sql, sizeof(sql), "ALTER TABLE %s ADD COLUMN ts INTEGER DEFAULT 0;", TABLE_NAME);
+            sqlite3_exec(db, sql, NULL, NULL, NULL);
+        }
+        sqlite3_finalize(stat);
+        stat = NULL;
+
+        // file created in WAL mode before auto vacuum was set never gives pages back, rebuild it once
+        if( SQLITE_OK == sqlite3_prepare_v2(db, "PRAGMA auto_vacuum;", -1, &stat, NULL) &&
+            SQLITE_ROW == sqlite3_step(stat) && sqlite3_column_int(stat, 0) != 2 ) {
+            sqlite3_finalize(stat);
+            stat = NULL;
+            logWarn("database file '%s' has no incremental auto vacuum, rebuild it\n", fname);
+            if( SQLITE_OK != sqlite3_exec(db, "PRAGMA auto_vacuum = 2; VACUUM;", NULL, NULL, &errmsg) ) {
+                logError("rebuild database file '%s' failure: %s\n", fname, errmsg);
+                sqlite3_free(errmsg);
+                errmsg = NULL;
+            }
+        }
+        sqlite3_finalize(stat);
+    }
+
+    /* connection settings are not saved in file, so they are set on every open. in WAL mode a
+     * commit only appends to the log, and NORMAL syncs it at checkpoint only but never corrupts
+     */
+    sqlite3_exec(db, "PRAGMA journal_mode = WAL;", NULL, NULL, NULL);
+    snprintf(sql, sizeof(sql), "PRAGMA synchronous = %s;", sync_names[opt->sync - DATABASE_SYNC_OFF]);
+    sqlite3_exec(db, sql, NULL, NULL, NULL);
+
+    // SQL is compiled once, every spool operation only binds and steps
+    if( dbsqlitePrepare("INSERT INTO %s(rowid, packet, ts) VALUES(?, ?, ?);", &stmt.push) < 0 ||
+        dbsqlitePrepare("SELECT rowid, packet FROM %s WHERE rowid > ? ORDER BY rowid LIMIT ?;", &stmt.popn) < 0 ||
+        dbsqlitePrepare("SELECT rowid, ts, LENGTH(packet) FROM %s WHERE rowid > ? ORDER BY rowid LIMIT ?;", &stmt.scan) < 0 ||
+        dbsqlitePrepare("SELECT LENGTH(packet) FROM %s WHERE rowid = ?;", &stmt.size) < 0 ||
+        dbsqlitePrepare("DELETE FROM %s WHERE rowid = ?;", &stmt.del) < 0 ||
+        dbsqlitePrepare("UPDATE %s SET packet = ? WHERE rowid = ?;", &stmt.update) < 0 ||
+        dbsqlitePrepare("PRAGMA freelist_count;", &stmt.freelist) < 0 ||
+        dbsqliteCount(next_id, rows, bytes) < 0 ) {
+        dbsqliteClose();
+        return -4;
+    }
+
+    logInfo("sqlite database file \"%s\", synchronous %s\n", fname, sync_names[opt->sync - DATABASE_SYNC_OFF]);
+    return 0;
+}
+
+
+/* description :    commit inserted packets of group commit
+ *  input args :
+ *      $force :    1: commit now   0: commit only if row or time limit is reached
+ * return value:    <0: failure   0: success
+ */
+static int dbsqliteCommit(int force) {
+
+    // no transaction is open
+    if( sqlite3_get_autocommit(db) ) {
+        return 0;
+    }
+    if( !force && group.pending < group.opt.commit_rows && clockMonoMs() - group.first_ms < group.opt.commit_ms ) {
+        return 0;
+    }
+
+    // transaction stays open when commit failure, it's tried again next time
+    if( SQLITE_OK != sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) ) {
+        logError("commit %d pushed packets failure: %s\n", group.pending, sqlite3_errmsg(db));
+        return -2;
+    }
+    logDebug("commit %d pushed packets\n", group.pending);
+    group.pending = 0;
+
+    return 0;
+}
+
+
+/* description :    get time until inserted packets must be committed
+ * return value:    -1: no packet waits for commit   >=0: milliseconds
+ */
+static int dbsqliteTimeout(void) {
+
+    int64_t         left;
+
+    if( sqlite3_get_autocommit(db) ) {
+        return -1;
+    }
+
+    left = group.first_ms + group.opt.commit_ms - clockMonoMs();
+
+    return left > 0 ? (int)left : 0;
+}
+
+
+/* description :    insert a packet into database file in group commit transaction
+ *  input args :
+ *         $id :    blob packet record id
+ *       $time :    blob packet time, epoch milliseconds, first sample time or push time
+ *       $pack :    blob packet data address
+ *       $size :    blob packet data bytes
+ * return value:    <0: failure   0: success
+ */
+static int dbsqliteInsert(int64_t id, int64_t time, void *pack, int size) {
+
+    int                 rv = 0;
+
+    // packets are inserted in one transaction until it's committed by dbsqliteCommit()
+    if( group.opt.commit_rows > 1 && sqlite3_get_autocommit(db) ) {
+        if( SQLITE_OK != sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) ) {
+            logError("begin transaction failure: %s\n", sqlite3_errmsg(db));
+            return -5;
+        }
+        group.first_ms = clockMonoMs();
+    }
+
+    // bind record id, blob packet data and time on SQL command
+    sqlite3_bind_int64(stmt.push, 1, id);
+    sqlite3_bind_int64(stmt.push, 3, time);
+    if( SQLITE_OK != sqlite3_bind_blob(stmt.push, 2, pack, size, SQLITE_STATIC) ) {
+        logError("function sqlite3_bind_blob() failure when push blob packet\n");
+        rv = -3;
+        goto Cleanup;
+    }
+
+    // execute SQL command
+    rv = sqlite3_step(stmt.push);
+    if( SQLITE_DONE != rv && SQLITE_ROW != rv ) {
+        logError("function sqlite3_step() failure when push blob packet\n");
+        rv = -4;
+        goto Cleanup;
+    }
+    rv = 0;
+    if( group.opt.commit_rows > 1 ) {
+        group.pending++;
+        dbsqliteCommit(0);
+    }
+
+ Cleanup:
+    dbsqliteReset(stmt.push);
+
+    if( rv < 0 ) {
+        logError("add new blob packet[%lld] into database failure, rv = %d\n", (long long)id, rv);
+    }
+    else {
+        logInfo("add new blob packet[%lld] into database success\n", (long long)id);
+    }
+    return rv;
+}
+
+
+/* description :    pop blob packets after a record from database file in one query
+ *  input args :
+ *      $after :    record id of last popped packet
+ *      $packs :    popped packets output, data points into $buf
+ *      $count :    most packets popped
+ *        $buf :    blob packets data output buffer
+ *       $size :    blob packets data output buffer size
+ *       $more :    set when there are packets left after popped ones
+ * return value:    <0: failure   >=0: packets popped
+ */
+static int dbsqlitePop(int64_t after, database_pack_t *packs, int count, void *buf, int size, int *more) {
+
+    int                 rv = 0;
+    int                 n = 0;
+    int                 used = 0;
+    int                 bytes = 0;
+    const void          *blob_ptr;
+
+    sqlite3_bind_int64(stmt.popn, 1, after);
+    sqlite3_bind_int(stmt.popn, 2, count);
+
+    // all packets are read in one statement, so in one read transaction
+    while( SQLITE_ROW == (rv = sqlite3_step(stmt.popn)) ) {
+        blob_ptr = sqlite3_column_blob(stmt.popn, 1);
+        bytes = sqlite3_column_bytes(stmt.popn, 1);
+        if( !blob_ptr ) {
+            continue;
+        }
+        if( used + bytes > size ) {
+            break;
+        }
+
+        packs[n].id = sqlite3_column_int64(stmt.popn, 0);
+        packs[n].data = (char *)buf + used;
+        packs[n].bytes = bytes;
+        memcpy(packs[n].data, blob_ptr, bytes);
+        used += bytes;
+        n++;
+    }
+    dbsqliteReset(stmt.popn);
+
+    if( SQLITE_ROW != rv && SQLITE_DONE != rv ) {
+        logError("function sqlite3_step() failure when pop blob packets: %s\n", sqlite3_errmsg(db));
+        return -4;
+    }
+    if( !n && SQLITE_ROW == rv ) {
+        logError("blob packet bytes[%d] is larger than bufsize[%d]\n", bytes, size);
+        return -7;
+    }
+
+    // LIMIT reached or buffer full, there may be more rows
+    *more = (SQLITE_ROW == rv || n == count);
+
+    return n;
+}
+
+
+/* description :    get information of packets after a record from database file
+ *  input args :
+ *      $after :    record id of last packet
+ *      $metas :    packets information output
+ *      $count :    most packets
+ * return value:    <0: failure   >=0: packets count
+ */
+static int dbsqliteScan(int64_t after, database_meta_t *metas, int count) {
+
+    int                 rv = 0;
+    int                 n = 0;
+
+    sqlite3_bind_int64(stmt.scan, 1, after);
+    sqlite3_bind_int(stmt.scan, 2, count);
+
+    while( n < count && SQLITE_ROW == (rv = sqlite3_step(stmt.scan)) ) {
+        metas[n].id = sqlite3_column_int64(stmt.scan, 0);
+        metas[n].time = sqlite3_column_int64(stmt.scan, 1);
+        metas[n].bytes = sqlite3_column_int(stmt.scan, 2);
+        n++;
+    }
+    dbsqliteReset(stmt.scan);
+
+    if( SQLITE_ROW != rv && SQLITE_DONE != rv ) {
+        logError("function sqlite3_step() failure when scan blob packets: %s\n", sqlite3_errmsg(db));
+        return -4;
+    }
+
+    return n;
+}
+
+
+/* description :    remove blob packets from database file in one transaction
+ *  input args :
+ *        $ids :    blob packet record ids
+ *      $count :    record ids count
+ *      $bytes :    removed packets bytes
+ * return value:    <0: failure   >=0: packets removed
+ */
+static int dbsqliteDel(int64_t *ids, int count, int64_t *bytes) {
+
+    int         rv = 0;
+    int         i;
+    int         removed = 0;
+
+    // inserted packets are committed first, deletion is a transaction of it's own
+    dbsqliteCommit(1);
+
+    // one journal write and sync for all packets instead of one for each
+    if( SQLITE_OK != sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) ) {
+        logError("begin transaction failure: %s\n", sqlite3_errmsg(db));
+        return -3;
+    }
+
+    *bytes = 0;
+    for( i = 0; i < count; i++ ) {
+
+        // packet may be removed already by retention
+        sqlite3_bind_int64(stmt.size, 1, ids[i]);
+        rv = sqlite3_step(stmt.size);
+        if( SQLITE_ROW == rv ) {
+            *bytes += sqlite3_column_int(stmt.size, 0);
+            removed++;
+        }
+        dbsqliteReset(stmt.size);
+        if( SQLITE_ROW != rv ) {
+            continue;
+        }
+
+        sqlite3_bind_int64(stmt.del, 1, ids[i]);
+        rv = sqlite3_step(stmt.del);
+        dbsqliteReset(stmt.del);
+        if( SQLITE_DONE != rv ) {
+            logError("delete blob packet[%lld] from database failure: %s\n", (long long)ids[i], sqlite3_errmsg(db));
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            return -4;
+        }
+    }
+
+    // no VACUUM here, it renumbers rowid of packets still in flight
+    if( SQLITE_OK != sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) ) {
+        logError("commit transaction failure: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return -5;
+    }
+    logInfo("delete %d blob packets from database success\n", removed);
+
+    return removed;
+}
+
+
+/* description :    replace data of a packet by thinned one in group commit transaction, record
+ *                  id and time column are kept
+ *  input args :
+ *         $id :    blob packet record id
+ *       $pack :    new blob packet data address
+ *       $size :    new blob packet data bytes
+ *      $bytes :    bytes freed
+ * return value:    <0: failure   0: success
+ */
+static int dbsqliteUpdate(int64_t id, void *pack, int size, int64_t *bytes) {
+
+    int                 rv = 0;
+    int                 old = 0;
+
+    // packet may be removed already
+    sqlite3_bind_int64(stmt.size, 1, id);
+    if( SQLITE_ROW == sqlite3_step(stmt.size) ) {
+        old = sqlite3_column_int(stmt.size, 0);
+    }
+    dbsqliteReset(stmt.size);
+    if( !old ) {
+        return -2;
+    }
+
+    // thinned packets are written in group commit transaction as inserted ones
+    if( group.opt.commit_rows > 1 && sqlite3_get_autocommit(db) ) {
+        if( SQLITE_OK != sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) ) {
+            logError("begin transaction failure: %s\n", sqlite3_errmsg(db));
+            return -5;
+        }
+        group.first_ms = clockMonoMs();
+    }
+
+    sqlite3_bind_int64(stmt.update, 2, id);
+    if( SQLITE_OK != sqlite3_bind_blob(stmt.update, 1, pack, size, SQLITE_STATIC) ) {
+        logError("function sqlite3_bind_blob() failure when update blob packet\n");
+        rv = -3;
+        goto Cleanup;
+    }
+
+    if( SQLITE_DONE != sqlite3_step(stmt.update) ) {
+        logError("update blob packet[%lld] failure: %s\n", (long long)id, sqlite3_errmsg(db));
+        rv = -4;
+        goto Cleanup;
+    }
+    *bytes = old - size;
+    if( group.opt.commit_rows > 1 ) {
+        group.pending++;
+        dbsqliteCommit(0);
+    }
+
+ Cleanup:
+    dbsqliteReset(stmt.update);
+
+    return rv;
+}
+
+
+/* description :    get free pages count of database file
+ * return value:    <0: failure   >=0: free pages
+ */
+static int dbsqliteFreePages(void) {
+
+    int         pages = -1;
+
+    if( SQLITE_ROW == sqlite3_step(stmt.freelist) ) {
+        pages = sqlite3_column_int(stmt.freelist, 0);
+    }
+    dbsqliteReset(stmt.freelist);
+
+    return pages;
+}
+
+
+/* description :    reclaim free pages of database file by incremental vacuum
+ *  input args :
+ *       $idle :    1: no backlog is draining, reclaim all free pages
+ *                  0: backlog is draining, reclaim a step only if free pages pass threshold
+ * return value:    <0: failure   >=0: pages reclaimed
+ */
+static int dbsqliteVacuum(int idle) {
+
+    char        sql[SQL_COMMAND_LEN] = {0};
+    char        *errmsg = NULL;
+    int         before = 0;
+    int         after = 0;
+
+    before = dbsqliteFreePages();
+    if( before < 0 ) {
+        logError("get database free pages failure: %s\n", sqlite3_errmsg(db));
+        return -2;
+    }
+    if( !before || (!idle && before < VACUUM_FREE_PAGES) ) {
+        return 0;
+    }
+
+    // vacuum runs out of group commit transaction
+    dbsqliteCommit(1);
+
+    // it only moves pages at file tail and truncates file, rowid of packets is kept
+    snprintf(sql, sizeof(sql), "PRAGMA incremental_vacuum(%d);", idle ? 0 : VACUUM_STEP_PAGES);
+    if( SQLITE_OK != sqlite3_exec(db, sql, NULL, NULL, &errmsg) ) {
+        logError("database incremental vacuum failure: %s\n", errmsg);
+        sqlite3_free(errmsg);
+        return -3;
+    }
+
+    after = dbsqliteFreePages();
+    if( after < 0 || after > before ) {
+        after = before;
+    }
+    vacuum.runs++;
+    vacuum.pages += before - after;
+    logInfo("database vacuum reclaimed %d of %d free pages, total %lld pages in %lld steps\n",
+            before - after, before, (long long)vacuum.pages, (long long)vacuum.runs);
+
+    return before - after;
+}
+
+
+database_backend_t dbsqlite_backend = {
+    .name = "sqlite",
+    .open = dbsqliteOpen,
+    .close = dbsqliteClose,
+    .insert = dbsqliteInsert,
+    .pop = dbsqlitePop,
+    .scan = dbsqliteScan,
+    .del = dbsqliteDel,
+    .update = dbsqliteUpdate,
+    .commit = dbsqliteCommit,
+    .timeout = dbsqliteTimeout,
+    .vacuum = dbsqliteVacuum,
+};
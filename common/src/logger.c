@@ -23,6 +23,7 @@
 #include <pthread.h>
 
 #include "logger.h"
+#include "clock.h"
 
 typedef void (*log_LockFunc)(void *udata, int lock);
 
@@ -57,13 +58,11 @@ static const char *level_colors[] = {
  *					$time_buf: buffer which store time str
  */
 static inline void timeToStr(char *time_buf, int size) {
-       
-    time_t 			t = time(NULL);
-    struct tm 		*tm = localtime(&t);
-    
-    memset(time_buf, 0, size);
-    strftime(time_buf, size, "%Y-%m-%d %H:%M:%S", tm);
-    
+
+    if( clockLocalStr(clockNowMs(), time_buf, size) < 0 ) {
+        time_buf[0] = '\0';
+    }
+
     return;
 }
 
@@ -21,6 +21,7 @@
 #include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/signalfd.h>
 
 #include "process.h"
 #include "logger.h"
@@ -84,6 +85,35 @@ void installDefaultSignal(void) {
 }
 
 
+/* description:     block SIGINT and SIGTERM and deliver them through a signalfd instead, so
+ *                  event loop can wait on them. Call it before any thread is started, threads
+ *                  inherit the blocked signal mask
+ * return value:    <0: failure   >=0: signalfd
+ */
+int installSignalFd(void) {
+
+    sigset_t            mask;
+    int                 fd = -1;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+
+    if( (fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0 ) {
+        logError("create signalfd failure: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if( pthread_sigmask(SIG_BLOCK, &mask, NULL) ) {
+        logError("block SIGINT and SIGTERM failure\n");
+        close(fd);
+        return -2;
+    }
+
+    return fd;
+}
+
+
 /*	description:	check daemon process running or not
  *	 input args:	
  *					$pidfile: file path whitch record PID
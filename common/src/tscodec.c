@@ -0,0 +1,306 @@
+/*********************************************************************************
+ *      Copyright:  (C) 2026 Company
+ *                  All rights reserved.
+ *
+ *       Filename:  tscodec.c
+ *    Description:  This file is a time series compression function file. Timestamps
+ *                  are delta of delta coded, integer values are zigzag delta coded,
+ *                  both in byte aligned varints. Regular sampled, slowly changing
+ *                  temperature takes about one byte per point.
+ *                 
+ *        Version:  1.0.0(2026年10月17日)
+ *         Author:  agent <agent@local>
+ *      ChangeLog:  1, Release initial version on "2026年10月17日 01时06分52秒"
+ *                 
+ ********************************************************************************/
+
+#include <string.h>
+#include <limits.h>
+#include "tscodec.h"
+
+// most bytes of a 64 bits varint
+#define TSCODEC_VARINT_MAX      10
+
+
+/*	description:	init time series buffer for encoding or decoding
+ *	 input args:	
+ *					$tb   : time series buffer
+ *					$buf  : data buffer
+ *					$size : buffer size when encoding, data bytes when decoding
+ */
+void tscodecInit(tscodec_buf_t *tb, void *buf, int size) {
+
+    tb->buf = buf;
+    tb->size = size;
+    tb->len = 0;
+
+    return;
+}
+
+
+/*	description:	encode unsigned integer as LEB128 varint, 7 bits per byte
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$value : integer
+ */
+void tscodecPutVarint(tscodec_buf_t *tb, uint64_t value) {
+
+    unsigned char       byte;
+
+    do {
+        byte = value & 0x7f;
+        value >>= 7;
+        if( value ) {
+            byte |= 0x80;
+        }
+        if( tb->len < tb->size ) {
+            tb->buf[tb->len] = byte;
+        }
+        tb->len++;
+    } while( value );
+
+    return;
+}
+
+
+/*	description:	encode signed integer as zigzag varint, small magnitude takes few bytes
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$value : integer
+ */
+void tscodecPutSvarint(tscodec_buf_t *tb, int64_t value) {
+
+    // 0, -1, 1, -2, 2... map to 0, 1, 2, 3, 4...
+    tscodecPutVarint(tb, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+
+    return;
+}
+
+
+/*	description:	encode raw bytes
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$data  : bytes
+ *					$bytes : bytes count
+ */
+void tscodecPutRaw(tscodec_buf_t *tb, const void *data, int bytes) {
+
+    if( tb->len + bytes <= tb->size ) {
+        memcpy(tb->buf + tb->len, data, bytes);
+    }
+    tb->len += bytes;
+
+    return;
+}
+
+
+/*	description:	encode timestamps column: first timestamp, first delta, then delta of
+ *                  deltas, regular sample interval costs one byte per timestamp
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$ts    : timestamps
+ *					$count : timestamps count
+ */
+void tscodecPutTimes(tscodec_buf_t *tb, const int64_t *ts, int count) {
+
+    int                 i;
+    int64_t             delta = 0;
+
+    for( i = 0; i < count; i++ ) {
+        if( i == 0 ) {
+            tscodecPutSvarint(tb, ts[0]);
+        }
+        else {
+            // unsigned math, wraps the same way as decoder
+            tscodecPutSvarint(tb, (int64_t)((uint64_t)ts[i] - (uint64_t)ts[i - 1] - (uint64_t)delta));
+            delta = (int64_t)((uint64_t)ts[i] - (uint64_t)ts[i - 1]);
+        }
+    }
+
+    return;
+}
+
+
+/*	description:	encode values column: presence bitmap, then zigzag delta of every present
+ *                  value from previous present one
+ *	 input args:	
+ *					$tb      : time series buffer
+ *					$values  : values, value is ignored when it's not present
+ *					$present : 1 means value present, 0 means missing
+ *					$count   : values count
+ */
+void tscodecPutColumn(tscodec_buf_t *tb, const int *values, const unsigned char *present, int count) {
+
+    int                 i;
+    unsigned char       bits = 0;
+    int64_t             last = 0;
+
+    // presence bitmap, LSB first
+    for( i = 0; i < count; i++ ) {
+        if( present[i] ) {
+            bits |= 1 << (i % 8);
+        }
+        if( i % 8 == 7 || i == count - 1 ) {
+            tscodecPutRaw(tb, &bits, 1);
+            bits = 0;
+        }
+    }
+
+    for( i = 0; i < count; i++ ) {
+        if( present[i] ) {
+            tscodecPutSvarint(tb, (int64_t)values[i] - last);
+            last = values[i];
+        }
+    }
+
+    return;
+}
+
+
+/*	description:	finish encoding
+ *	 input args:	
+ *					$tb : time series buffer
+ * return value:    <0: buffer is too small   >=0: encoded bytes
+ */
+int tscodecEnd(tscodec_buf_t *tb) {
+
+    return tb->len <= tb->size ? tb->len : -1;
+}
+
+
+/*	description:	decode unsigned varint
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$value : integer output
+ * return value:    <0: truncated or too long   0: success
+ */
+int tscodecGetVarint(tscodec_buf_t *tb, uint64_t *value) {
+
+    int                 i;
+    unsigned char       byte;
+
+    *value = 0;
+    for( i = 0; i < TSCODEC_VARINT_MAX; i++ ) {
+        if( tb->len >= tb->size ) {
+            return -1;
+        }
+        byte = tb->buf[tb->len++];
+        *value |= (uint64_t)(byte & 0x7f) << (7 * i);
+        if( !(byte & 0x80) ) {
+            return 0;
+        }
+    }
+
+    return -2;
+}
+
+
+/*	description:	decode zigzag varint
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$value : integer output
+ * return value:    <0: truncated or too long   0: success
+ */
+int tscodecGetSvarint(tscodec_buf_t *tb, int64_t *value) {
+
+    uint64_t            zigzag;
+
+    if( tscodecGetVarint(tb, &zigzag) < 0 ) {
+        return -1;
+    }
+    *value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+
+    return 0;
+}
+
+
+/*	description:	decode raw bytes, data points into time series buffer
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$data  : bytes output
+ *					$bytes : bytes count
+ * return value:    <0: truncated   0: success
+ */
+int tscodecGetRaw(tscodec_buf_t *tb, const unsigned char **data, int bytes) {
+
+    if( bytes < 0 || bytes > tb->size - tb->len ) {
+        return -1;
+    }
+    *data = tb->buf + tb->len;
+    tb->len += bytes;
+
+    return 0;
+}
+
+
+/*	description:	decode timestamps column
+ *	 input args:	
+ *					$tb    : time series buffer
+ *					$ts    : timestamps output
+ *					$count : timestamps count
+ * return value:    <0: truncated   0: success
+ */
+int tscodecGetTimes(tscodec_buf_t *tb, int64_t *ts, int count) {
+
+    int                 i;
+    int64_t             value;
+    int64_t             delta = 0;
+
+    for( i = 0; i < count; i++ ) {
+        if( tscodecGetSvarint(tb, &value) < 0 ) {
+            return -1;
+        }
+        if( i == 0 ) {
+            ts[0] = value;
+        }
+        else {
+            // unsigned math, corrupted input wraps instead of overflow
+            delta = (int64_t)((uint64_t)delta + (uint64_t)value);
+            ts[i] = (int64_t)((uint64_t)ts[i - 1] + (uint64_t)delta);
+        }
+    }
+
+    return 0;
+}
+
+
+/*	description:	decode values column
+ *	 input args:	
+ *					$tb      : time series buffer
+ *					$values  : values output, missing value is 0
+ *					$present : presence output
+ *					$count   : values count
+ * return value:    <0: truncated or value out of range   0: success
+ */
+int tscodecGetColumn(tscodec_buf_t *tb, int *values, unsigned char *present, int count) {
+
+    int                 i;
+    const unsigned char *bits;
+    int64_t             delta;
+    int64_t             last = 0;
+
+    if( tscodecGetRaw(tb, &bits, (count + 7) / 8) < 0 ) {
+        return -1;
+    }
+
+    for( i = 0; i < count; i++ ) {
+        present[i] = (bits[i / 8] >> (i % 8)) & 1;
+        values[i] = 0;
+        if( !present[i] ) {
+            continue;
+        }
+        if( tscodecGetSvarint(tb, &delta) < 0 ) {
+            return -2;
+        }
+        if( delta < (int64_t)INT_MIN * 2 || delta > (int64_t)INT_MAX * 2 ) {
+            return -3;
+        }
+        last += delta;
+        if( last < INT_MIN || last > INT_MAX ) {
+            return -3;
+        }
+        values[i] = (int)last;
+    }
+
+    return 0;
+}